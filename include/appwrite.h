@@ -7,7 +7,8 @@ class FigmaQml;
 
 namespace AppWrite {
 #ifdef HAS_QUL
-bool writeQul(const QString& path, const FigmaQml& figmaQml, bool writeAsApp, const QVector<int>& elements);
+// preconvertImages dithers opaque images to RGB565 before the resource compiler converts them
+bool writeQul(const QString& path, const FigmaQml& figmaQml, bool writeAsApp, const QVector<int>& elements, bool preconvertImages = false);
 #ifdef HAS_EXECUTE
 bool executeQulApp(const QVariantMap& parameters, const FigmaQml& figmaQml, const QVector<int>& elements);
 #endif
@@ -0,0 +1,66 @@
+#ifndef CONTENTHASH_H
+#define CONTENTHASH_H
+
+#include <QByteArray>
+#include <QtEndian>
+#include <cstring>
+
+/**
+ * @brief hash64, 64-bit content hash (xxHash64 algorithm) used to identify output files.
+ */
+inline quint64 hash64(const char* data, qsizetype length, quint64 seed = 0) {
+    constexpr quint64 P1 = 11400714785074694791ULL;
+    constexpr quint64 P2 = 14029467366897019727ULL;
+    constexpr quint64 P3 = 1609587929392839161ULL;
+    constexpr quint64 P4 = 9650029242287828579ULL;
+    constexpr quint64 P5 = 2870177450012600261ULL;
+    const auto rotl = [](quint64 x, int r) {return (x << r) | (x >> (64 - r));};
+    const auto read64 = [](const char* p) {quint64 v; std::memcpy(&v, p, sizeof(v)); return qFromLittleEndian(v);};
+    const auto read32 = [](const char* p) {quint32 v; std::memcpy(&v, p, sizeof(v)); return qFromLittleEndian(v);};
+    const auto round = [rotl](quint64 acc, quint64 input) {return rotl(acc + input * P2, 31) * P1;};
+    const auto merge = [round](quint64 acc, quint64 v) {return (acc ^ round(0, v)) * P1 + P4;};
+
+    const char* p = data;
+    const char* const end = data + length;
+    quint64 h;
+    if(length >= 32) {
+        quint64 v1 = seed + P1 + P2;
+        quint64 v2 = seed + P2;
+        quint64 v3 = seed;
+        quint64 v4 = seed - P1;
+        for(; p + 32 <= end; p += 32) {
+            v1 = round(v1, read64(p));
+            v2 = round(v2, read64(p + 8));
+            v3 = round(v3, read64(p + 16));
+            v4 = round(v4, read64(p + 24));
+        }
+        h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+        h = merge(h, v1);
+        h = merge(h, v2);
+        h = merge(h, v3);
+        h = merge(h, v4);
+    } else {
+        h = seed + P5;
+    }
+    h += static_cast<quint64>(length);
+    for(; p + 8 <= end; p += 8)
+        h = rotl(h ^ round(0, read64(p)), 27) * P1 + P4;
+    if(p + 4 <= end) {
+        h = rotl(h ^ (static_cast<quint64>(read32(p)) * P1), 23) * P2 + P3;
+        p += 4;
+    }
+    for(; p < end; ++p)
+        h = rotl(h ^ (static_cast<quint64>(static_cast<quint8>(*p)) * P5), 11) * P1;
+    h ^= h >> 33;
+    h *= P2;
+    h ^= h >> 29;
+    h *= P3;
+    h ^= h >> 32;
+    return h;
+}
+
+inline quint64 hash64(const QByteArray& data) {
+    return hash64(data.constData(), data.size());
+}
+
+#endif // CONTENTHASH_H
@@ -22,6 +22,7 @@ constexpr auto IMAGE_PREFIX =  "images/";
 constexpr auto QML_EXT = ".qml";
 
 class FigmaQml;
+class OutputManifest;
 class QProcess; // not defined in WASM
 
 namespace ExecuteUtils {
@@ -62,9 +63,10 @@ namespace ExecuteUtils {
      * @param main_file_name
      * @param figmaQml
      * @param indices
+     * @param manifest - files already having the same content are not rewritten
      * @return
      */
-    std::optional<std::tuple<QStringList, QSet<QString>>> writeElement(const QString& path, const QString& main_file_name, const FigmaQml& figmaQml, const std::pair<int, int>& indices);
+    std::optional<std::tuple<QStringList, QSet<QString>>> writeElement(const QString& path, const QString& main_file_name, const FigmaQml& figmaQml, const std::pair<int, int>& indices, OutputManifest& manifest);
 
 
     /**
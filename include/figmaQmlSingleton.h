@@ -76,15 +76,19 @@ private:
     // Propagates loader source change accross UI where loaders can than capture it
 
     void applyExternalLoaders(bool usePlaceHolder) {
+        QList<QPair<QString, QUrl>> sources;
         for(const auto& [bytes, name] : m_fqml.externalLoaders()) {
             if(usePlaceHolder) {
-                emit setSource(name, QUrl("qrc:///LoaderPlaceHolder.qml"));
+                sources.append({name, QUrl("qrc:///LoaderPlaceHolder.qml")});
             } else {
                 const auto component_name = FigmaQml::validFileName("placeholder_" + name + FIGMA_SUFFIX);
                 m_fqml.writeQmlFile(component_name, bytes, m_fqml.makeHeader());
-                emit setSource(name, component_name + ".qml");
+                sources.append({name, component_name + ".qml"});
             }
         }
+        m_fqml.flushOutput();
+        for(const auto& [name, source] : sources)
+            emit setSource(name, source);
     }
 private:
      FigmaQml& m_fqml;
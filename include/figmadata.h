@@ -6,6 +6,9 @@
 #include <QDataStream>
 #include <QMutex>
 #include <tuple>
+#include <optional>
+#include <numeric>
+#include "contenthash.h"
 
 //TODO: Change to QReadWriteLock - for perf?
 #define MUTEX_LOCK(m) QMutexLocker _l(&m);
@@ -30,6 +33,17 @@ public:
         return m_data[key].state == State::Error;
     }
 
+    /**
+     * @brief tryData, data and format if committed, a single lookup thus safe from the other threads
+     */
+    std::optional<std::tuple<QByteArray, int>> tryData(const QString& key) const {
+        MUTEX_LOCK(m_mutex);
+        const auto it = m_data.constFind(key);
+        if(it == m_data.constEnd() || it->state != State::Committed)
+            return std::nullopt;
+        return std::make_tuple(it->data, it->format);
+    }
+
     QByteArray data(const QString& key) const {
         MUTEX_LOCK(m_mutex);
         Q_ASSERT(m_data[key].state == State::Committed);
@@ -90,8 +104,9 @@ public:
     }
 
     void setBytes(const QString& key, const QByteArray& bytes, int meta =  0) {
+        MUTEX_LOCK(m_mutex);
         Q_ASSERT(m_data[key].state == State::Pending);
-        m_data[key].data = bytes;
+        m_data[key].data = shared(bytes);
         m_data[key].format = meta;
         m_data[key].state = State::Committed;
     }
@@ -110,14 +125,25 @@ public:
     }
 
     void clear(){
-        m_data.clear();
+        MUTEX_LOCK(m_mutex);
+        doClear();
+    }
+
+    /**
+     * @brief sharedBytes, size of the duplicate data that is not stored
+     */
+    qint64 sharedBytes() const {
+        MUTEX_LOCK(m_mutex);
+        return m_sharedBytes;
     }
 
     int size() const {
+        MUTEX_LOCK(m_mutex);
         return m_data.size();
     }
 
     void write(QDataStream& stream) const {
+        MUTEX_LOCK(m_mutex);
         const int size = std::accumulate(m_data.begin(), m_data.end(), 0, [](const auto &a, const auto& c){return c.state != State::Committed ? a : a + 1;});
         stream << size;
         const auto keys = m_data.keys();
@@ -136,7 +162,8 @@ public:
     void read(QDataStream& stream) {
         int size;
         stream >> size;
-        clear();
+        MUTEX_LOCK(m_mutex);
+        doClear();
         for(int i = 0; i < size; i++) {
             QString key;
             QString d1;
@@ -148,8 +175,26 @@ public:
             stream >> d2;
             stream >> format;
             stream >> state;
-            m_data.insert(key, {d1, d2, format, state});
+            m_data.insert(key, {d1, shared(d2), format, state});
+        }
+    }
+private:
+    void doClear() {
+        m_data.clear();
+        m_blobs.clear();
+        m_sharedBytes = 0;
+    }
+
+    // identical blobs (e.g. same bitmap with several keys) share the data
+    QByteArray shared(const QByteArray& bytes) {
+        const auto hash = hash64(bytes);
+        const auto it = m_blobs.constFind(hash);
+        if(it != m_blobs.constEnd() && *it == bytes) {
+            m_sharedBytes += bytes.size();
+            return *it;
         }
+        m_blobs.insert(hash, bytes);
+        return bytes;
     }
 private:
     struct Data {
@@ -159,6 +204,8 @@ private:
         State state;
     };
     QHash <QString, Data > m_data;
+    QHash<quint64, QByteArray> m_blobs; // content hash -> data
+    qint64 m_sharedBytes = 0;
     mutable QMutex m_mutex;
 };
 
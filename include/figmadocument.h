@@ -2,11 +2,17 @@
 #define FIGMADOCUMENT_H
 
 #include <QHash>
+#include <QSet>
+#include <QStringList>
 #include <QString>
 #include <QByteArray>
 #include <QJsonObject>
 #include <QJsonDocument>
 #include <QFile>
+#include <QCryptographicHash>
+#include "outputwriter.h"
+#include "qmlstore.h"
+#include <algorithm>
 #include <vector>
 
 class FigmaDocument {
@@ -38,6 +44,10 @@ public:
         }
 
         virtual bool addElement(const QString& name, const QByteArray& data) = 0;
+        // replace data of an existing element, e.g. a lazily generated one
+        virtual bool setElement(int index, const QByteArray& data) = 0;
+        // drop data of an element that is no more needed
+        virtual void release(int index) = 0;
 
         int size() const {
             return static_cast<int>(m_elements.size());
@@ -112,6 +122,40 @@ public:
             m_componentMap[name].unite(QSet<QString>(components.begin(), components.end()));
         else
             m_componentMap.insert(name, QSet<QString>(components.begin(), components.end()));
+        m_closures.clear();
+        m_order.clear();
+    }
+
+    /**
+     * @brief dependencies, components an element or a component uses, transitively. Sorted.
+     */
+    QStringList dependencies(const QString& name) const {
+        auto it = m_closures.constFind(name);
+        if(it == m_closures.constEnd()) {
+            QSet<QString> closure;
+            collect(closure, name);
+            auto list = closure.values();
+            list.sort();
+            it = m_closures.insert(name, list);
+        }
+        return *it;
+    }
+
+    /**
+     * @brief componentOrder, all components so that each comes after the components it uses
+     */
+    QStringList componentOrder() const {
+        if(m_order.isEmpty() && !m_componentMap.isEmpty()) {
+            QSet<QString> components;
+            for(const auto& c : m_componentMap)
+                components.unite(c);
+            auto names = m_componentMap.keys();
+            names.sort(); // same order for the same document
+            QSet<QString> visited;
+            for(const auto& n : names)
+                order(n, components, visited);
+        }
+        return m_order;
     }
 
 
@@ -119,11 +163,35 @@ public:
     virtual bool containsComponent(const QString& name) const = 0;
     virtual void addComponent(const QString& name, const QJsonObject& obj, const QByteArray& data) = 0;
 
+private:
+    void collect(QSet<QString>& closure, const QString& name) const {
+        for(const auto& c : m_componentMap.value(name)) {
+            if(!closure.contains(c)) {
+                closure.insert(c);
+                collect(closure, c);
+            }
+        }
+    }
+
+    void order(const QString& name, const QSet<QString>& components, QSet<QString>& visited) const {
+        if(visited.contains(name))
+            return;
+        visited.insert(name);
+        auto uses = m_componentMap.value(name).values();
+        uses.sort();
+        for(const auto& c : uses)
+            order(c, components, visited);
+        if(components.contains(name))
+            m_order.append(name);
+    }
 protected:
     const QString m_name;
     int m_current = 0;
     CanvasVector m_canvas;
     QHash<QString, QSet<QString>> m_componentMap;
+private:
+    mutable QHash<QString, QStringList> m_closures;
+    mutable QStringList m_order;
 };
 
 enum class DocumentType {
@@ -136,15 +204,23 @@ class FigmaFileDocument : public FigmaDocument {
         public:
             ElementFile(const QString& name, const QString& directory) : m_name(name), m_data((directory + name + ".qml").toLatin1()) {
             }
-            bool bless(const QByteArray& data) {
-               QFile f(m_data);
-                if(f.exists()) {
+            bool bless(const QByteArray& data, OutputWriter& writer, QmlStore* store) {
+                if(store) {
+                    store->insert(m_name + ".qml", data);
+                    return true;
+                }
+                if(QFile::exists(m_data)) {
                    qDebug() << "Not replace" << m_name;
                    return true;
                 }
-               if(!f.open(QIODevice::WriteOnly))
-                   return false;
-               f.write(data);
+               writer.write(m_data, data);
+               return true;
+            }
+            bool rewrite(const QByteArray& data, OutputWriter& writer, QmlStore* store) {
+               if(store)
+                   store->insert(m_name + ".qml", data);
+               else
+                   writer.write(m_data, data);
                return true;
             }
             QByteArray data() const override {return m_data;}
@@ -154,27 +230,46 @@ class FigmaFileDocument : public FigmaDocument {
             const QByteArray m_data;
         };
     public:
-        explicit CanvasFile(const QString& name, const QString* directory) : Canvas(name), m_directory(directory) {}
+        explicit CanvasFile(const QString& name, const QString* directory, OutputWriter* writer, QmlStore* store) : Canvas(name), m_directory(directory), m_writer(writer), m_store(store) {}
         bool addElement(const QString& name, const QByteArray& data) override {
              Q_ASSERT(!name.isEmpty());
              Q_ASSERT(!data.isEmpty());
              m_elements.push_back(std::make_unique<ElementFile>(name, *m_directory));
-             if(!reinterpret_cast<ElementFile*>(m_elements.back().get())->bless(data))
+             if(!reinterpret_cast<ElementFile*>(m_elements.back().get())->bless(data, *m_writer, m_store))
                  return false;
              return true;
          }
+        bool setElement(int index, const QByteArray& data) override {
+             Q_ASSERT(index >= 0 && index < size());
+             Q_ASSERT(!data.isEmpty());
+             return reinterpret_cast<ElementFile*>(m_elements[index].get())->rewrite(data, *m_writer, m_store);
+         }
+        void release(int) override {} // data is in the file
     private:
         const QString* m_directory;
+        OutputWriter* m_writer;
+        QmlStore* m_store;
     };
 public:
      static DocumentType type() {return DocumentType::FileDocument;}
-     FigmaFileDocument(const QString& directory, const QString& name) : FigmaDocument(name), m_directory(directory) {
+     /**
+      * @brief FigmaFileDocument
+      * @param directory - where element files are written
+      * @param name - document name
+      * @param writer - element files are written using the writer, it has to be flushed before files are used
+      * @param store - if set, elements are kept there instead of files
+      */
+     FigmaFileDocument(const QString& directory, const QString& name, OutputWriter& writer, QmlStore* store) : FigmaDocument(name), m_directory(directory), m_writer(writer), m_store(store) {
      }
 
      ~FigmaFileDocument() {
+         m_writer.flush(); // pending files are removed too
          for(const auto& c : *this) {
              for(const auto& e : *c) {
-                 QFile::remove(e->data());
+                 if(m_store)
+                     m_store->remove(e->name() + ".qml");
+                 else
+                     QFile::remove(e->data());
              }
          }
      }
@@ -190,11 +285,13 @@ public:
      }
 
      Canvas* addCanvas(const QString& canvasName) override  {
-         m_canvas.push_back(std::make_unique<CanvasFile>(canvasName, &m_directory));
+         m_canvas.push_back(std::make_unique<CanvasFile>(canvasName, &m_directory, &m_writer, m_store));
          return m_canvas.back().get();
      }
 private:
     const QString m_directory;
+    OutputWriter& m_writer;
+    QmlStore* m_store;
     QSet<QString> m_components;
 };
 
@@ -218,19 +315,27 @@ class FigmaDataDocument : public FigmaDocument {
              m_elements.push_back(std::make_unique<ElementData>(name, data));
              return true;
          }
+        bool setElement(int index, const QByteArray& data) override {
+             Q_ASSERT(index >= 0 && index < size());
+             Q_ASSERT(!data.isEmpty());
+             m_elements[index] = std::make_unique<ElementData>(m_elements[index]->name(), data);
+             return true;
+         }
+        void release(int index) override {
+             Q_ASSERT(index >= 0 && index < size());
+             m_elements[index] = std::make_unique<ElementData>(m_elements[index]->name(), QByteArray());
+         }
     };
 public:
     static DocumentType type() {return DocumentType::DataDocument;}
-    FigmaDataDocument(const QString& directory, const QString& name) : FigmaDocument(name) {
+    FigmaDataDocument(const QString& directory, const QString& name, OutputWriter& writer, QmlStore* store) : FigmaDocument(name) {
         Q_UNUSED(directory);
+        Q_UNUSED(writer);
+        Q_UNUSED(store);
     }
 
     QStringList components(const QString& elementName) const {
-        QSet<QString> allComponents;
-        getComponents(allComponents, elementName);
-        QStringList lst = allComponents.values();
-        lst.sort();
-        return lst;
+        return dependencies(elementName);
     }
 
     Canvas* addCanvas(const QString& canvasName) override {
@@ -242,99 +347,96 @@ public:
         return m_components.contains(name);
     }
 
-    static int remove_comments(const QByteArray& data, unsigned& end) {
-        if(data[end] != '/' || (end + 1 == static_cast<unsigned>(data.size())))
-            return 0;
-        if(data[end + 1] == '/') {
-            ++end;
-            while((end < static_cast<unsigned>(data.size())) && data[++end] != '\n');
-            return 1;
-        } else if(data[end + 1] == '*') {
-            ++end;
-            int lines = 0;
-            while(end < static_cast<unsigned>(data.size())) {
-                const auto c = data[end++];
-                if(c == '\n')
-                    ++lines;
-                if(c == '*' && (end < static_cast<unsigned>(data.size())) && data[end] == '/') {
-                    ++end;
-                    return lines;
+    /**
+     * @brief normalized QML, comments are removed and whitespaces are collapsed, strings are kept as is.
+     * Line breaks are kept for diagnostics.
+     */
+    static QByteArray normalized(const QByteArray& data) {
+        QByteArray out;
+        out.reserve(data.size());
+        bool space = false;
+        for(qsizetype i = 0; i < data.size(); ++i) {
+            const auto c = data[i];
+            if(c == '/' && i + 1 < data.size() && data[i + 1] == '/') {
+                while(i + 1 < data.size() && data[i + 1] != '\n')
+                    ++i;
+            } else if(c == '/' && i + 1 < data.size() && data[i + 1] == '*') {
+                const auto close = data.indexOf("*/", i + 2);
+                i = close < 0 ? data.size() : close + 1;
+                space = true;
+            } else if(c == '\n') {
+                space = false;
+                if(!out.isEmpty() && out.back() == ' ')
+                    out.chop(1);
+                if(!out.isEmpty() && out.back() != '\n')
+                    out += '\n';
+            } else if(c == ' ' || c == '\t' || c == '\r') {
+                space = true;
+            } else {
+                if(space && !out.isEmpty() && out.back() != '\n')
+                    out += ' ';
+                space = false;
+                out += c;
+                if(c == '"' || c == '\'') {
+                    for(++i; i < data.size(); ++i) {
+                        out += data[i];
+                        if(data[i] == '\\' && i + 1 < data.size())
+                            out += data[++i];
+                        else if(data[i] == c)
+                            break;
+                    }
                 }
             }
-        } else {
-            return 0;
         }
-        return 0;
+        return out;
+    }
+
+    static QByteArray contentHash(const QByteArray& data) {
+        return QCryptographicHash::hash(normalized(data), QCryptographicHash::Md5);
     }
 
     void addComponent(const QString& name, const QJsonObject& obj, const QByteArray& data) override {
         Q_ASSERT(!name.isEmpty());
         Q_ASSERT(!data.isEmpty());
-        if(m_components.contains(name)) {
-            if(qChecksum(data) == qChecksum(m_components[name].first)) {
+        auto hash = contentHash(data);
+        const auto it = m_components.constFind(name);
+        if(it != m_components.constEnd()) {
+            if(it->hash == hash)
                 return;
-            }
-            unsigned rbegin = 0;
-            unsigned cbegin = 0;
-            unsigned cend = 0;
-            unsigned rend = 0;
-            const auto& ref = m_components[name].first;
-            auto cline = 1;
-            auto rline = 1;
-            while((cend < static_cast<unsigned>(data.size())) && (rend < static_cast<unsigned>(ref.size()))) {
-                const auto c = data[cend];
-                const auto r = ref[rend];
-                cline += remove_comments(data, cend);
-                rline += remove_comments(ref, rend);
-                if(c == '\n' && r != '\n')
-                    ++rend;
-                else if(c != '\n' && r == '\n')
-                    ++cend;
-                else if (c == '\n' || r == '\n') {
-                    auto c_slice= data.mid(cbegin, cend).simplified();
-                    auto r_slice= ref.mid(rbegin, rend).simplified();
-                    if(c_slice != r_slice) {
-                        qDebug() << "warn:" << name << "mismatch component" << cline << rline << data.mid(cbegin, cend) << "\n\n" << ref.mid(rbegin, rend);
-                        break;
-                    }
-                    ++rend;
-                    ++cend;
-                    cbegin = cend;
-                    rbegin = rend;
-                    ++rline;
-                    ++cline;
-                } else {
-                    ++rend;
-                    ++cend;
+#ifdef COMPONENT_DIFF
+#pragma message("COMPONENT_DIFF is defined, component mismatches are reported...")
+            const auto lines = normalized(data).split('\n');
+            const auto refLines = normalized(it->data).split('\n');
+            for(qsizetype i = 0; i < std::max(lines.size(), refLines.size()); ++i) {
+                const auto line = lines.value(i);
+                const auto refLine = refLines.value(i);
+                if(line != refLine) {
+                    qDebug() << "warn:" << name << "mismatch component at" << i + 1 << line << "\n\n" << refLine;
+                    break;
                 }
             }
-            if((cend == static_cast<unsigned>(data.size())) || (rend == static_cast<unsigned>(ref.size())))
-                qDebug() << "warn:" << name << "were close component";
+#endif
         }
-        m_components.insert(name, {data, QJsonDocument(obj).toJson()});
+        m_components.insert(name, {data, QJsonDocument(obj).toJson(), std::move(hash)});
     }
 
     QByteArray component(const QString& componentName) const {
         Q_ASSERT(m_components.contains(componentName));
-        return m_components[componentName].first;
+        return m_components[componentName].data;
     }
 
     QByteArray componentObject(const QString& componentName) const {
         Q_ASSERT(m_components.contains(componentName));
-        return m_components[componentName].second;
+        return m_components[componentName].object;
     }
 
 private:
-    void getComponents(QSet<QString>& componentSet, const QString& elementName) const {
-        for(const QString& component : m_componentMap[elementName]) {
-            if(!componentSet.contains(component)){
-                componentSet.insert(component);
-                getComponents(componentSet, component);
-            }
-        }
-    }
-private:
-    QHash<QString, QPair<QByteArray, QByteArray>> m_components;
+    struct ComponentData {
+        QByteArray data;
+        QByteArray object;
+        QByteArray hash; // of normalized data
+    };
+    QHash<QString, ComponentData> m_components;
 };
 
 
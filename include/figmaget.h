@@ -2,6 +2,7 @@
 #define FIGMAGET_H
 
 #include "figmaprovider.h"
+#include "imageresize.h"
 #include <QTime>
 #include <QMutex>
 #include <QTimer>
@@ -51,7 +52,6 @@ public slots:
 signals:
     void dataChanged();
     //void fetchingChanged(bool fetching);
-    void error(const QString& errorString);
     void intervalChanged(int interval);
     void imagesPopulated();
     void imageRendered(const QString& figmaId);
@@ -73,6 +73,7 @@ private:
     void monitorReply(QNetworkReply* reply, const std::shared_ptr<QByteArray>& bytes,
                       const FinishedFunction& finalize, bool showProgress = true);
     void queueCall(const NetworkFunction& call);
+    void cancelResizes();
     QByteArray image(const Id& imageRef, const QByteArray& imageData) const;
     bool write(QDataStream& stream, unsigned flag, const QVariantMap& imports) const;
     bool read(QDataStream& stream);
@@ -109,6 +110,9 @@ private:
     std::unique_ptr<FigmaData> m_renderings;
     std::unique_ptr<FigmaData> m_nodes;
     std::atomic_bool m_populationOngoing = false;
+    int m_resizing = 0; // images under resize in the thread pool
+    unsigned m_resizeEpoch = 0; // resizes of an earlier epoch are cancelled
+    QList<QFuture<ImageResize::Result>> m_resizes;
     int m_throttle = 300; //Idea of throttle is collect requests into queue and bunches to reduce especially renderig requests
     QQueue<NetworkFunction> m_callQueue;
     QTimer m_callTimer;
@@ -0,0 +1,87 @@
+#ifndef FIGMAIMAGEPROVIDER_H
+#define FIGMAIMAGEPROVIDER_H
+
+#include "figmaprovider.h"
+#include <QQuickImageProvider>
+#include <QCache>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QImage>
+#include <QUrl>
+#include <algorithm>
+
+/**
+ * @brief The FigmaImageProvider class serves the images of the viewed document from the FigmaProvider
+ * cache as "image://figma/<revision>/image/<imageRef>" and "image://figma/<revision>/rendering/<figmaId>".
+ * Decoded images are cached, hence a refresh does not decode them again. The revision changes when the
+ * fetched data is reset, thus the engine does not show its cached pixmaps of the earlier data.
+ *
+ * Images are requested from the QML engine loader thread.
+ */
+class FigmaImageProvider : public QQuickImageProvider {
+public:
+    static constexpr auto Id = "figma";
+    static constexpr int CacheSizeKb = 256 * 1024;
+
+    static QByteArray url(const QString& imageRef, bool isRendering, unsigned revision) {
+        return QByteArray("image://") + Id + '/' + QByteArray::number(revision) + (isRendering ? "/rendering/" : "/image/") + QUrl::toPercentEncoding(imageRef);
+    }
+
+    explicit FigmaImageProvider(FigmaProvider& provider) :
+        QQuickImageProvider(QQuickImageProvider::Image, QQmlImageProviderBase::ForceAsynchronousImageLoading),
+        m_provider(provider) {
+        m_images.setMaxCost(CacheSizeKb);
+    }
+
+    QImage requestImage(const QString& id, QSize* size, const QSize& requestedSize) override {
+        const auto image = decoded(id);
+        if(size)
+            *size = image.size();
+        if(image.isNull() || !requestedSize.isValid() || requestedSize == image.size())
+            return image;
+        const QSize scaled(requestedSize.width() > 0 ? requestedSize.width() : image.width(),
+                           requestedSize.height() > 0 ? requestedSize.height() : image.height());
+        return image.scaled(scaled, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+    }
+
+    void clear() {
+        QMutexLocker lock(&m_mutex);
+        m_images.clear();
+    }
+private:
+    struct Decoded {
+        QByteArray source; // shares the data with the provider, thus changes are detected
+        QImage image;
+    };
+
+    QImage decoded(const QString& id) {
+        const auto revision = id.indexOf('/');
+        const auto slash = revision < 0 ? -1 : id.indexOf('/', revision + 1);
+        if(slash < 0)
+            return {};
+        const auto isRendering = QStringView(id).mid(revision + 1, slash - revision - 1) == QLatin1String("rendering");
+        const auto imageRef = QUrl::fromPercentEncoding(id.mid(slash + 1).toLatin1());
+        const auto data = isRendering ? m_provider.cachedRendering(imageRef) : m_provider.cachedImage(imageRef);
+        if(!data)
+            return {};
+        const auto& bytes = std::get<QByteArray>(*data);
+        {
+            QMutexLocker lock(&m_mutex);
+            const auto entry = m_images.object(id);
+            if(entry && (entry->source.isSharedWith(bytes) || entry->source == bytes))
+                return entry->image;
+        }
+        const auto image = QImage::fromData(bytes);
+        if(image.isNull())
+            return {};
+        QMutexLocker lock(&m_mutex);
+        m_images.insert(id, new Decoded{bytes, image}, std::max(1, static_cast<int>(image.sizeInBytes() / 1024)));
+        return image;
+    }
+private:
+    FigmaProvider& m_provider;
+    QMutex m_mutex;
+    QCache<QString, Decoded> m_images;
+};
+
+#endif // FIGMAIMAGEPROVIDER_H
@@ -11,6 +11,7 @@
 #include <QTextStream>
 #include <QSet>
 #include <QStack>
+#include <QVarLengthArray>
 #include <QFont>
 #include <QColor>
 #include <optional>
@@ -37,9 +38,9 @@ class FigmaParser {
 private:
     // this is set of contexts where a image is used
     using ImageContexts =  QSet<QString>;
+public:
     // Components as filename -> object + qml code
     using ComponentStreams = QHash<QByteArray, std::tuple<QJsonObject, QByteArray/*, QString*/>>;
-public:
     // Loader (for asLoader replacement) id --> obj + name
     using ExternalLoaders = QHash<QString, std::tuple<QByteArray, QString>>;
 public:
@@ -82,6 +83,7 @@ public:
         Element& operator=(const Element& other) = delete;
         const QString& id() const {return m_id;}
         const QString& name() const {return m_name;}
+        const QString& type() const {return m_type;}
         const QByteArray& data() const {return m_data;}
         const QStringList& components() const {return m_componentIds;}
         const QStringList& imageContexts() const {return m_imageContexts;}
@@ -113,7 +115,7 @@ public:
             m_name(name), m_id(id), m_key(key),
             m_description(description), m_object(object) {}
         QString name() const {
-            Q_ASSERT(m_name.endsWith(FIGMA_SUFFIX) || validFileName(m_name, false) == m_name);
+            Q_ASSERT(m_name.isEmpty() || m_name.endsWith(FIGMA_SUFFIX));
             return m_name;
         }
         const QString& description() const {return m_description;}
@@ -150,18 +152,19 @@ public:
     };
     using EByteArray = std::optional<QByteArray>;
 public:
-    static std::optional<Components> components(const QJsonObject& project,  FigmaParserData& data);
+    static std::optional<Components> components(const QJsonObject& project,  FigmaParserData& data, const QSet<QString>* roots = nullptr);
+    static QSet<QString> componentDependencies(const QJsonObject& obj);
     static std::optional<Canvases> canvases(const QJsonObject& project);
     static std::optional<Element> component(const QJsonObject& obj, unsigned flags,  FigmaParserData& data, const Components& components);
     static std::optional<Element> element(const QJsonObject& obj, unsigned flags,  FigmaParserData& data, const Components& components);
     static QString name(const QJsonObject& project);
     static QString lastError();
     static QString makeFileName(const QString& itemName);
+    static QByteArray makeClipRect(const QRect& rect);
 private:
     enum class StrokeType {Normal, Double, OnePix};
     enum class ItemType {None, Vector, Text, Frame, Component, Boolean, Instance};
 private:
-    static QString validFileName(const QString& itemName, bool inited);
     static QHash<QString, QJsonObject> getObjectsByType(const QJsonObject& obj, const QString& type);
     static QJsonObject delta(const QJsonObject& instance, const QJsonObject& base,
                              const QSet<QString>& ignored,
@@ -176,6 +179,7 @@ private:
     static QByteArray toColor(double r, double g, double b, double a = 1.0);
     QByteArray makeId(const QJsonObject& obj);
     QByteArray makeId(const QString& prefix,  const QJsonObject& obj);
+    const QByteArray& qmlId(const QJsonObject& obj);
     EByteArray makeComponentInstance(const QString& type, const QJsonObject& obj, int indents, const QByteArray& change_receiver = QByteArray());
     EByteArray makeItem(const QString& type, const QJsonObject& obj, int indents, const QByteArray& change_receiver = QByteArray());
 
@@ -279,23 +283,22 @@ private:
      ~FigmaParser();
      std::tuple<QByteArray, QString> makePathAlias(int pathIndex, const QJsonObject& obj, int indents);
 private:
+     // objects from the element root to the object currently parsed
      struct Parent{
-         const QJsonObject* obj;
-         const Parent* parent;
-         QSet<QString> ids;
+         const QJsonObject* obj = nullptr;
+         QVarLengthArray<const QJsonObject*, 32> stack;
          template<typename T>
          auto operator[](const T& k) const {return (*obj)[k];}
+         bool isEmpty() const {return stack.isEmpty();}
+         bool isTopLevel() const {return stack.size() == 1;}
          void push(const QJsonObject* obj_) {
-             parent = new Parent{obj, parent, {}};
+             stack.append(obj_);
              obj = obj_;
          }
          void pop() {
-             Q_ASSERT(parent);
-             obj = parent->obj;
-             auto p = parent;
-             parent = p->parent;
-             ids += p->ids;
-             delete p;
+             Q_ASSERT(!stack.isEmpty());
+             stack.removeLast();
+             obj = stack.isEmpty() ? nullptr : stack.last();
          }
      };
      struct Alias {
@@ -313,6 +316,7 @@ private:
     const QString m_indent = "    ";
     QSet<QString> m_componentIds;
     Parent m_parent;
+    QHash<QString, QByteArray> m_qmlIds; // figma id -> qml id
     ImageContexts m_imageContext;
     QVector<Alias> m_aliases;
     int m_componentLevel = 0;
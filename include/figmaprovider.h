@@ -3,6 +3,8 @@
 
 #include <QObject>
 #include <QSize>
+#include <QRect>
+#include <optional>
 #include <limits>
 
 class FigmaProvider : public QObject {
@@ -21,6 +23,7 @@ public:
     virtual std::tuple<int, int, int> cacheInfo() const = 0;
     virtual void reset() = 0;
 signals:
+    void error(const QString& errorString);
     void imageReady(const QString& imageRef, const QByteArray& bytes, int format);
     void renderingReady(const QString& figmaId, const QByteArray& bytes, int format);
     void nodeReady(const QString& figmaId);
@@ -31,10 +34,13 @@ class FigmaParserData {
 public:
     virtual void parseError(const QString&, bool isFatal) = 0;
     virtual QByteArray imageData(const QString&, bool isRendering) = 0;
+    virtual std::optional<QRect> imageClip(const QString&) const = 0; // part of the image file, if packed
     virtual QByteArray nodeData(const QString&) = 0;
     virtual QString fontInfo(const QString&) = 0;
     virtual QString qmlTargetDir() const = 0;
     virtual unsigned unique_number() = 0;
+    virtual QString uniqueName(const QString& id, const QString& name) const = 0;
+    virtual bool isCancelled() = 0; // polled for every parsed node
 };
 
 
@@ -8,6 +8,10 @@
 #include <QVariantMap>
 #include <QUrl>
 #include <QVector>
+#include <QPointer>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QFuture>
 #include <memory>
 #include <optional>
 
@@ -15,6 +19,11 @@ class FigmaFileDocument;
 class FigmaDataDocument;
 class FontCache;
 class FontInfo;
+class NodeCache;
+class NameRegistry;
+class OutputWriter;
+class QmlStore;
+class ImageAtlas;
 class FigmaQmlSingleton;
 
 
@@ -59,14 +68,19 @@ public:
         KeepFigmaFontName           = 0x80000,
         LoaderPlaceHolders          = 0x100000,
         RenderLoaderPlaceHolders    = 0x200000,
+        AtlasImages                 = 0x400000,
+        QulPreconvertImages         = 0x800000,
     };
     Q_ENUM(Flags)
 public:
      void parseError(const QString&, bool isFatal) override;
      QByteArray imageData(const QString&, bool isRendering) override;
+     std::optional<QRect> imageClip(const QString&) const override;
      QByteArray nodeData(const QString&) override;
      QString fontInfo(const QString&) override;
      unsigned unique_number() override;
+     bool isCancelled() override;
+     QString uniqueName(const QString& id, const QString& name) const override;
 public:
     FigmaQml(const QString& qmlDir, const QString& fontFolder, FigmaProvider& provider, QObject* parent = nullptr);
     ~FigmaQml();
@@ -91,12 +105,22 @@ public:
     bool setBrokenPlaceholder(const QString& placeholder);
     bool isValid() const;
     void setFilter(const QMap<int, QSet<int>>& filter);
+    // pages and frames as indices (starting from 1), names or ids, resolved when the document is created
+    void setFilter(const QStringList& pages, const QStringList& frames);
+    // generate elements only when they are viewed (or saved)
+    void setLazy(bool lazy);
+    // elements are generated when saved and released once written, memory is bounded by the largest element
+    void setStreaming(bool streaming);
     void restore(int flags, const QVariantMap& imports);
     QString documentsLocation() const;
     QVariantList elements() const;
     const auto& externalLoaders() const {return m_externalLoaders;}
     QStringList supportedQulHardware() const;
     Q_INVOKABLE bool saveAllQML(const QString& folderName);
+#ifdef ZIP_EXPORT
+    // write into a zip archive, "-" writes to stdout
+    Q_INVOKABLE bool saveAllQMLToZip(const QString& zipName);
+#endif
     Q_INVOKABLE bool saveQML(bool asMcu, const QString& folderName, bool writeAsApp, const QVector<int>& elements);
     Q_INVOKABLE void cancel();
     Q_INVOKABLE static QString validFileName(const QString& name);
@@ -106,6 +130,8 @@ public:
     Q_INVOKABLE QByteArray prettyData(const QByteArray& data) const;
     Q_INVOKABLE void setFontMapping(const QString& key, const QString& value);
     Q_INVOKABLE void resetFontMappings();
+    // font folder fonts are added when used, this adds all of them
+    Q_INVOKABLE void registerFolderFonts();
     Q_INVOKABLE void setSignals(bool allow);
     //void takeSnap(const QString& pngName) const;
     Q_INVOKABLE static QString nearestFontFamily(const QString& requestedFont, bool useQt);
@@ -113,6 +139,8 @@ public:
     Q_INVOKABLE void executeApp(const QVariantMap& parameters, const QVector<int>& elements);
     Q_INVOKABLE bool hasFontPathInfo() const;
     Q_INVOKABLE void findFontPath(const QString& fontFamilyName) const;
+    // paths of all the given fonts in one query, emitted as fontPathsFound
+    Q_INVOKABLE void findFontPaths(const QStringList& fontFamilyNames) const;
 #ifdef USE_NATIVE_FONT_DIALOG
     // sigh font native dialog wont work on WASM and QML dialog is buggy
     Q_INVOKABLE void showFontDialog(const QString& currentFont);
@@ -124,9 +152,19 @@ public:
     Q_INVOKABLE void restore();
 #endif
     std::optional<QStringList> saveImages(const QString &folder, const QSet<QString>& filter = {}) const;
+    // written on the background, flushOutput has to be called before the file is used
     bool writeQmlFile(const QString& component_name, const QByteArray& element_data, const QByteArray& header, const QString& subFolder = {});
+    // wait pending files to be written, returns false if any write failed
+    bool flushOutput() const;
+    // viewed QML is kept in the store instead of files
+    void setQmlStore(const std::shared_ptr<QmlStore>& store);
+    // viewed images are referred as FigmaImageProvider URLs instead of embedding them
+    void setImageProvider(bool hasProvider);
     QByteArray makeHeader() const;
-    bool testFileExists(const QString& filename, const QByteArray& data) const;
+    // elements rebuilt and reused on the last document generation
+    std::tuple<int, int> elementStats() const;
+    // components not used by any converted element, thus not generated
+    QStringList unusedComponents() const;
     Q_INVOKABLE void reset(bool keepFonts, bool keepSources, bool keepImages, bool keepFetch);
 public slots:
     void createDocumentView(const QByteArray& data, bool restoreView);
@@ -164,6 +202,7 @@ signals:
     void fontFolderChanged();
     void fontLoaded(const QFont& font);
     void fontPathFound(const QString& fontPath);
+    void fontPathsFound(const QVariantMap& fontPaths); // family -> path
     void fontPathError(const QString& error);
     void elementsChanged();
     void externalLoadersApplied(const QString& name, const QString& source);
@@ -178,47 +217,120 @@ private slots:
     void doCancel();
     void updateDefaultImports();
     void applyExternalLoaders();
+private:
+    struct LazyState {
+        FigmaParser::Components components;
+        QByteArray header;
+        bool embedImages;
+        bool providedImages;
+        QByteArray cacheContext;                        // node cache context of the document
+        QHash<QString, QByteArray> componentHashes;
+        QHash<QPair<int, int>, QJsonObject> pending;   // canvas, element -> element object
+    };
+    // document under construction, kept when the construction is suspended and continued from where it stopped
+    struct Construction {
+        std::optional<FigmaParser::Canvases> canvases;
+        std::optional<FigmaParser::Components> components;
+        QByteArray header;
+        QSet<QString> writtenComponents;
+        int canvas = 0;             // canvas in progress
+        int element = 0;            // next element of the canvas
+    };
 private:
     void addImageFile(const QString& imageRef, bool isRendering);
     bool addImageFileData(const QString& imageRef, const QByteArray& bytes, int mime);
+    void reportImageStats() const;
+    QByteArray fontState() const;
+    void loadFontCache();
+    void saveFontCache();
+    void writeAtlas();
+    void clearImageFiles();
     bool ensureDirExists(const QString& dirname) const;
-    bool doCreateDocument(FigmaDocument& doc, const QJsonObject& json);
+    bool doCreateDocument(FigmaDocument& doc, const QJsonObject& json, LazyState* lazy, Construction& construction);
     template<class FigmaDocType>
     void createDocument(const QJsonObject& json);
     std::optional<QJsonObject> object(const QByteArray& bytes);
     void cleanDir(const QString& dirName);
     std::optional<std::tuple<QByteArray, int>> getImage(const QString& imageRef, bool isRendering);
     void suspend();
-    bool writeComponents(FigmaDocument& doc, const FigmaParser::Components& components, const QByteArray& header);
-    bool setDocument(FigmaDocument& doc, const FigmaParser::Canvases& canvases, const FigmaParser::Components& components, const QByteArray& header);
+    bool sliceUsed();
+    bool writeComponents(FigmaDocument& doc, Construction& construction);
+    bool setDocument(FigmaDocument& doc, Construction& construction, LazyState* lazy);
+    bool addElement(FigmaDocument& doc, FigmaDocument::Canvas& canvas, const QString& name, int index,
+                    const FigmaParser::Element& element, const FigmaParser::Components& components, const QByteArray& header);
+    bool generatePending(FigmaDocument* doc, LazyState* lazy, int canvasIndex, int elementIndex);
+    void generateCurrent();
+    void prefetch(int canvasIndex, int elementIndex, bool next, bool source);
+    bool generateAll();
+    bool generateSource(int canvasIndex, int elementIndex);
+    bool applySelection(const FigmaParser::Canvases& canvases);
+    bool isFiltered(int canvasIndex, int elementIndex) const;
+    std::optional<FigmaParser::Element> makeElement(const QJsonObject& obj, const FigmaParser::Components& components, bool isComponent);
+    bool restoreImages(const FigmaParser::Element& element);
+    QString resolveFont(const QString& requestedFont);
+    void registerFolderFont(const QString& family);
     QString qmlTargetDir() const override;
-    std::optional<QString> uniqueFilename(const QString& filename, const QByteArray& data);
+    std::optional<QString> uniqueFilename(const QString& filename, const QByteArray& data, QString* existing = nullptr);
+    void abortDocument();
+    bool deferred(const std::function<void ()>& call);
+    std::optional<int> writeSources(const std::function<bool (const QString& fileName, const QByteArray& data)>& write);
 private:
     const QString m_qmlDir;
     FigmaProvider& mProvider;
+    std::unique_ptr<OutputWriter> m_writer; // documents flush it when destroyed
+    std::shared_ptr<QmlStore> m_qmlStore;
     std::unique_ptr<FigmaFileDocument> m_uiDoc;
     std::unique_ptr<FigmaDataDocument> m_sourceDoc;
+    std::unique_ptr<LazyState> m_lazyView;
+    std::unique_ptr<LazyState> m_lazySource;
+    bool m_lazy = false;
+    bool m_streaming = false;
     QVariantMap m_imports;
     int m_imageDimensionMax = 1024;
     bool m_busy = false;
     unsigned m_flags = 0;
     QByteArray m_brokenPlaceholder;
     QMap<int, QSet<int>> m_filter;
+    QStringList m_pageSelection;
+    QStringList m_frameSelection;
     QHash<QString, QPair<QString, QString>> m_imageFiles;
+    QHash<quint64, QString> m_imageNames; // content hash -> image file name
+    QHash<QString, QByteArray> m_imageData; // image file name -> content, shared with the provider cache
+    qint64 m_duplicateImageBytes = 0;
+    std::unique_ptr<ImageAtlas> m_atlas;
+    QHash<QString, QRect> m_imageClips;     // imageRef -> rect in atlas
+    QHash<quint64, QRect> m_atlasRects;     // content hash -> rect in atlas
     QString m_snap;
     std::unique_ptr<FontCache> m_fontCache;
+    QString m_fontCacheFile;
+    std::unique_ptr<NodeCache> m_nodeCache;
+    std::unique_ptr<NameRegistry> m_names;
+    QHash<QString, QString> m_usedFonts;
+    QStringList m_unusedComponents;
     QString m_fontFolder;
+    QFuture<void> m_fontScan;
+    unsigned m_fontScans = 0;
+    QMultiHash<QString, QString> m_folderFonts;    // lower case and normalized family -> font file
+    QSet<QString> m_registeredFonts;               // font files added to the font database
+    QSet<QString> m_folderFamilies;                // families of the added font files
     std::atomic_bool m_doCancel = false;    
     std::atomic_bool m_ok = true;
     bool m_embedImages = false;
+    bool m_hasImageProvider = false;
+    bool m_providedImages = false;
+    unsigned m_imageRevision = 0;
     enum class State {Constructing, Failed, Suspend};
     State m_state = State::Constructing;
     std::function<void (bool)> mRestore = nullptr;
+    QPointer<QTimer> m_createTimer;
+    QElapsedTimer m_yieldTimer;
+    bool m_yielding = false;        // in a nested event loop
+    bool m_yielded = false;         // construction was suspended as its time slice was used
     QHash<QString, QSet<QString>> m_imageContexts;
     FontInfo* m_fontInfo;
     FigmaParser::ExternalLoaders m_externalLoaders;
     unsigned m_unique_number = 1;
-    QHash<QString, quint16> m_crcs;
+    QHash<QString, quint64> m_hashes; // file name -> content hash
 };
 
 
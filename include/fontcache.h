@@ -3,9 +3,23 @@
 
 #include <QMutex>
 #include <QHash>
+#include <QSet>
 #include <QMutexLocker>
+#include <QDataStream>
+#include <QSaveFile>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <cstring>
+#include <utility>
 
+/**
+ * @brief The FontCache class maps the requested font families to the system fonts. Mappings
+ * set explicitly are kept apart from the resolved ones, only the latter are persisted.
+ */
 class FontCache {
+    static constexpr char StreamId[] = "FQFC";
+    static constexpr int StreamVersion = 1;
 public:
     void insert(const QString& key, const QString& value) {
         QMutexLocker lock(&m_mutex);
@@ -14,6 +28,14 @@ public:
         } else {
             m_fontMap.insert(key, value);
         }
+        m_resolved.remove(key);
+    }
+
+    void insertResolved(const QString& key, const QString& value) {
+        QMutexLocker lock(&m_mutex);
+        m_fontMap.insert(key, value);
+        m_resolved.insert(key);
+        m_dirty = true;
     }
 
     bool contains(const QString& key) const {
@@ -37,9 +59,78 @@ public:
     void clear() {
         QMutexLocker lock(&m_mutex);
         m_fontMap.clear();
+        m_resolved.clear();
+        m_dirty = false;
+    }
+
+    /**
+     * @brief clearResolved, forget resolved fonts e.g. when the installed fonts change. Explicit mappings are kept.
+     */
+    void clearResolved() {
+        QMutexLocker lock(&m_mutex);
+        for(const auto& key : std::as_const(m_resolved))
+            m_fontMap.remove(key);
+        m_resolved.clear();
+        m_dirty = false;
+    }
+
+    /**
+     * @brief load resolved fonts, existing mappings are kept. The file name is expected
+     * to identify the installed fonts, thus the stored values are valid.
+     */
+    bool load(const QString& fileName) {
+        QFile file(fileName);
+        if(!file.open(QIODevice::ReadOnly))
+            return false;
+        QDataStream stream(&file);
+        char id[4];
+        int version = 0;
+        if(stream.readRawData(id, 4) != 4 || std::memcmp(id, StreamId, 4) != 0)
+            return false;
+        stream >> version;
+        if(version != StreamVersion)
+            return false;
+        QHash<QString, QString> fonts;
+        stream >> fonts;
+        if(stream.status() != QDataStream::Ok)
+            return false;
+        QMutexLocker lock(&m_mutex);
+        for(const auto& [key, value] : fonts.asKeyValueRange()) {
+            if(!m_fontMap.contains(key)) {
+                m_fontMap.insert(key, value);
+                m_resolved.insert(key);
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @brief save resolved fonts if there are new ones
+     */
+    bool save(const QString& fileName) {
+        QMutexLocker lock(&m_mutex);
+        if(!m_dirty)
+            return true;
+        if(!QDir().mkpath(QFileInfo(fileName).absolutePath()))
+            return false;
+        QHash<QString, QString> fonts;
+        for(const auto& key : m_resolved)
+            fonts.insert(key, m_fontMap[key]);
+        QSaveFile file(fileName);
+        if(!file.open(QIODevice::WriteOnly))
+            return false;
+        QDataStream stream(&file);
+        stream.writeRawData(StreamId, 4);
+        stream << StreamVersion << fonts;
+        if(stream.status() != QDataStream::Ok || !file.commit())
+            return false;
+        m_dirty = false;
+        return true;
     }
 private:
      QHash<QString, QString> m_fontMap;
+     QSet<QString> m_resolved;  // keys that are not set explicitly
+     bool m_dirty = false;
      mutable QMutex m_mutex;
 };
 
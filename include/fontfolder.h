@@ -0,0 +1,143 @@
+#ifndef FONTFOLDER_H
+#define FONTFOLDER_H
+
+#include <QString>
+#include <QStringList>
+#include <QHash>
+#include <QDir>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QFile>
+#include <QSaveFile>
+#include <QDataStream>
+#include <QRawFont>
+#include <QFont>
+#include <QPromise>
+#include <QFuture>
+#if QT_CONFIG(thread)
+#include <QThreadPool>
+#endif
+#include <cstring>
+#include <memory>
+
+/**
+ * @brief FontFolder, lists the font families, weights and styles of the font files in a folder.
+ * They are read from the files only if the files are changed since the previous scan.
+ */
+namespace FontFolder {
+
+struct Face {
+    QStringList families;   // empty if not a font
+    int weight;             // QFont weight
+    bool italic;
+};
+
+using Families = QHash<QString, Face>; // font file path -> face
+
+namespace Private {
+    constexpr char StreamId[] = "FQFF";
+    constexpr int StreamVersion = 2;
+
+    struct Entry {
+        qint64 modified;
+        qint64 size;
+        Face face;
+    };
+
+    inline QHash<QString, Entry> load(const QString& cacheFile) {
+        QHash<QString, Entry> entries;
+        QFile file(cacheFile);
+        if(!file.open(QIODevice::ReadOnly))
+            return entries;
+        QDataStream stream(&file);
+        char id[4];
+        int version = 0;
+        if(stream.readRawData(id, 4) != 4 || std::memcmp(id, StreamId, 4) != 0)
+            return entries;
+        stream >> version;
+        if(version != StreamVersion)
+            return entries;
+        int count = 0;
+        stream >> count;
+        for(int i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+            QString path;
+            Entry entry;
+            stream >> path >> entry.modified >> entry.size >> entry.face.families >> entry.face.weight >> entry.face.italic;
+            entries.insert(path, entry);
+        }
+        if(stream.status() != QDataStream::Ok)
+            entries.clear();
+        return entries;
+    }
+
+    inline void save(const QString& cacheFile, const QHash<QString, Entry>& entries) {
+        if(!QDir().mkpath(QFileInfo(cacheFile).absolutePath()))
+            return;
+        QSaveFile file(cacheFile);
+        if(!file.open(QIODevice::WriteOnly))
+            return;
+        QDataStream stream(&file);
+        stream.writeRawData(StreamId, 4);
+        stream << StreamVersion << static_cast<int>(entries.size());
+        for(const auto& [path, entry] : entries.asKeyValueRange())
+            stream << path << entry.modified << entry.size << entry.face.families << entry.face.weight << entry.face.italic;
+        if(stream.status() == QDataStream::Ok)
+            file.commit();
+    }
+}
+
+/**
+ * @brief scan folder, cacheFile keeps the families of the files between the scans
+ */
+inline Families scan(const QString& folder, const QString& cacheFile) {
+    const auto cached = Private::load(cacheFile);
+    QHash<QString, Private::Entry> entries;
+    bool changed = false;
+    Families families;
+    for(const auto& info : QDir(folder).entryInfoList(QDir::Files)) {
+        if(info.fileName().endsWith(".txt"))
+            continue;
+        const auto path = info.absoluteFilePath();
+        const auto modified = info.lastModified().toMSecsSinceEpoch();
+        auto it = cached.constFind(path);
+        if(it != cached.constEnd() && it->modified == modified && it->size == info.size()) {
+            entries.insert(path, *it);
+        } else {
+            const QRawFont raw(path, 12);
+            const auto face = raw.isValid() ? Face{{raw.familyName()}, raw.weight(), raw.style() != QFont::StyleNormal} : Face{{}, QFont::Normal, false};
+            entries.insert(path, {modified, info.size(), face});
+            changed = true;
+        }
+        families.insert(path, entries[path].face);
+    }
+    if(changed || entries.size() != cached.size())
+        Private::save(cacheFile, entries);
+    return families;
+}
+
+/**
+ * @brief run, scan in the global thread pool
+ */
+inline QFuture<Families> run(const QString& folder, const QString& cacheFile) {
+#if QT_CONFIG(thread)
+    auto promise = std::make_shared<QPromise<Families>>();
+    auto future = promise->future();
+    promise->start();
+    QThreadPool::globalInstance()->start([promise, folder, cacheFile]() {
+        promise->addResult(scan(folder, cacheFile));
+        promise->finish();
+    });
+    return future;
+#else
+    QPromise<Families> promise;
+    auto future = promise.future();
+    promise.start();
+    promise.addResult(scan(folder, cacheFile));
+    promise.finish();
+    return future;
+#endif
+}
+
+}
+
+#endif // FONTFOLDER_H
@@ -0,0 +1,211 @@
+#ifndef FONTINDEX_H
+#define FONTINDEX_H
+
+#include <QString>
+#include <QStringList>
+#include <QHash>
+#include <QVector>
+#include <QVarLengthArray>
+#include <QRegularExpression>
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+#include <numeric>
+#include <optional>
+#include <vector>
+
+/**
+ * @brief The FontIndex class finds the font family nearest to the requested name. Names are
+ * normalised (case and weight suffixes are folded) and candidates are pre-filtered by trigrams
+ * before the edit distance is computed.
+ */
+class FontIndex {
+public:
+    explicit FontIndex(const QStringList& families) : m_families(families) {
+        m_entries.reserve(static_cast<size_t>(families.size()));
+        for(auto i = 0; i < families.size(); ++i) {
+            const auto name = normalized(families[i]);
+            m_entries.push_back({name, trigrams(name)});
+            if(!m_folded.contains(families[i].toLower()))
+                m_folded.insert(families[i].toLower(), i);
+            if(!m_exact.contains(name))
+                m_exact.insert(name, i);
+        }
+    }
+
+    const QStringList& families() const {
+        return m_families;
+    }
+
+    /**
+     * @brief nearest family, on equal distance the first one
+     */
+    std::optional<QString> nearest(const QString& requested) const {
+        if(m_families.isEmpty())
+            return std::nullopt;
+        const auto folded = m_folded.constFind(requested.toLower());
+        if(folded != m_folded.constEnd())
+            return m_families[*folded];
+        const auto name = normalized(requested);
+        const auto exact = m_exact.constFind(name);
+        if(exact != m_exact.constEnd())
+            return m_families[*exact];
+
+        // the most promising candidates first, then the bound prunes the rest
+        const auto grams = trigrams(name);
+        std::vector<int> shared(m_entries.size());
+        for(auto i = 0U; i < m_entries.size(); ++i)
+            shared[i] = common(grams, m_entries[i].trigrams);
+        std::vector<int> order(m_entries.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&shared](int a, int b) {return shared[static_cast<size_t>(a)] > shared[static_cast<size_t>(b)];});
+
+        int best = std::numeric_limits<int>::max();
+        int index = -1;
+        for(const auto i : order) {
+            const auto& entry = m_entries[static_cast<size_t>(i)];
+            const auto longer = static_cast<int>(std::max(name.size(), entry.name.size()));
+            if(best < std::numeric_limits<int>::max()) {
+                if(std::abs(static_cast<int>(name.size() - entry.name.size())) > best)
+                    continue;
+                // each edit removes at most 3 common trigrams
+                if(shared[static_cast<size_t>(i)] < longer - 2 - 3 * best)
+                    continue;
+            }
+            const auto d = distance(name, entry.name, best);
+            if(d < best || (d == best && i < index)) {
+                best = d;
+                index = i;
+            }
+        }
+        return m_families[index];
+    }
+
+    /**
+     * @brief normalized, lower case and the weight and style suffixes removed
+     */
+    static QString normalized(const QString& family) {
+        static const QStringList suffixes{"thin", "hairline", "extralight", "ultralight", "light",
+                                          "regular", "normal", "book", "medium", "semibold", "demibold",
+                                          "bold", "extrabold", "ultrabold", "black", "heavy", "italic", "oblique"};
+        static const QRegularExpression separators(R"([\s\-_]+)");
+        auto words = family.toLower().split(separators, Qt::SkipEmptyParts);
+        while(words.size() > 1 && suffixes.contains(words.last()))
+            words.removeLast();
+        return words.join(' ');
+    }
+
+    /**
+     * @brief distance, Levenshtein distance of a and b. Computed bit-parallel (Myers) when a
+     * fits into a word. Returns a value greater than bound as soon as bound is exceeded.
+     */
+    static int distance(const QString& a, const QString& b, int bound = std::numeric_limits<int>::max()) {
+        if(a.size() > 64)
+            return b.size() > 64 ? distanceDp(a, b, bound) : distance(b, a, bound);
+        const auto m = static_cast<int>(a.size());
+        const auto n = static_cast<int>(b.size());
+        if(m == 0)
+            return n;
+        if(std::abs(m - n) > bound)
+            return bound + 1;
+        // pattern bitmasks of each character of a
+        quint64 ascii[128] = {};
+        QVarLengthArray<std::pair<char16_t, quint64>, 8> other;
+        for(auto i = 0; i < m; ++i) {
+            const auto c = a[i].unicode();
+            if(c < 128) {
+                ascii[c] |= quint64(1) << i;
+            } else {
+                const auto it = std::find_if(other.begin(), other.end(), [c](const auto& p) {return p.first == c;});
+                if(it != other.end())
+                    it->second |= quint64(1) << i;
+                else
+                    other.append({c, quint64(1) << i});
+            }
+        }
+        const auto peq = [&ascii, &other](char16_t c) -> quint64 {
+            if(c < 128)
+                return ascii[c];
+            const auto it = std::find_if(other.begin(), other.end(), [c](const auto& p) {return p.first == c;});
+            return it != other.end() ? it->second : 0;
+        };
+        const quint64 high = quint64(1) << (m - 1);
+        quint64 pv = ~quint64(0);
+        quint64 mv = 0;
+        int score = m;
+        for(auto j = 0; j < n; ++j) {
+            const auto eq = peq(b[j].unicode());
+            const auto xv = eq | mv;
+            const auto xh = (((eq & pv) + pv) ^ pv) | eq;
+            auto ph = mv | ~(xh | pv);
+            auto mh = pv & xh;
+            if(ph & high)
+                ++score;
+            else if(mh & high)
+                --score;
+            // score can decrease at most one per remaining character
+            if(score - (n - j - 1) > bound)
+                return bound + 1;
+            ph = (ph << 1) | 1;
+            mh <<= 1;
+            pv = mh | ~(xv | ph);
+            mv = ph & xv;
+        }
+        return score;
+    }
+private:
+    static int distanceDp(const QString& a, const QString& b, int bound) {
+        std::vector<int> row(static_cast<size_t>(a.size()) + 1);
+        std::iota(row.begin(), row.end(), 0);
+        for(auto j = 1; j <= b.size(); ++j) {
+            int diagonal = row[0];
+            row[0] = j;
+            int rowMin = row[0];
+            for(auto i = 1; i <= a.size(); ++i) {
+                const auto up = row[static_cast<size_t>(i)];
+                row[static_cast<size_t>(i)] = std::min({up + 1, row[static_cast<size_t>(i - 1)] + 1, diagonal + (a[i - 1] == b[j - 1] ? 0 : 1)});
+                diagonal = up;
+                rowMin = std::min(rowMin, row[static_cast<size_t>(i)]);
+            }
+            if(rowMin > bound)
+                return bound + 1;
+        }
+        return row.back();
+    }
+
+    static QVector<quint64> trigrams(const QString& name) {
+        QVector<quint64> grams;
+        for(auto i = 0; i + 2 < name.size(); ++i)
+            grams.append((quint64(name[i].unicode()) << 32) | (quint64(name[i + 1].unicode()) << 16) | name[i + 2].unicode());
+        std::sort(grams.begin(), grams.end());
+        return grams;
+    }
+
+    // size of the multiset intersection
+    static int common(const QVector<quint64>& a, const QVector<quint64>& b) {
+        int count = 0;
+        for(auto i = a.cbegin(), j = b.cbegin(); i != a.cend() && j != b.cend();) {
+            if(*i < *j)
+                ++i;
+            else if(*j < *i)
+                ++j;
+            else {
+                ++count;
+                ++i;
+                ++j;
+            }
+        }
+        return count;
+    }
+private:
+    struct Entry {
+        QString name;
+        QVector<quint64> trigrams;
+    };
+    const QStringList m_families;
+    std::vector<Entry> m_entries;
+    QHash<QString, int> m_folded;   // lower case name -> first index
+    QHash<QString, int> m_exact;    // normalized name -> first index
+};
+
+#endif // FONTINDEX_H
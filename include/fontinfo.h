@@ -3,7 +3,13 @@
 
 #include <QFont>
 #include <QObject>
+#include <QVariantMap>
+#include <functional>
 
+/**
+ * @brief The FontInfo class resolves font file paths. Installed fonts are listed once
+ * into an index, then queries are resolved in process.
+ */
 class FontInfo : public QObject{
     Q_OBJECT
 public:
@@ -11,9 +17,16 @@ public:
     ~FontInfo();
     void getFontFilePath(const QString &family, QFont::Style style, int weight, int size);
     void getFontFilePath(const QFont& font);
+    // resolve all at once, result is emitted as fontPaths
+    void getFontFilePaths(const QList<QFont>& fonts);
+    // application fonts are not known by the system, weight is a QFont weight
+    void addFontFile(const QString& path, const QStringList& families, int weight, bool italic);
 signals:
     void fontPath(const QString& path);
+    void fontPaths(const QVariantMap& paths); // family -> path
     void pathError(const QString& error);
+private:
+    void whenIndexed(const std::function<void ()>& query);
 private:
     class Private;
     std::unique_ptr<Private> m_private;
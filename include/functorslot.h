@@ -42,7 +42,8 @@ public:
     }
 
     void cancel(const QString& id) {
-        Q_ASSERT(mTimers.contains(id));
+        if(!mTimers.contains(id))
+            return; // already reset
         auto t = std::get<QTimer*>(mTimers[id]);
         t->stop();
         t->deleteLater();
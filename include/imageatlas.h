@@ -0,0 +1,134 @@
+#ifndef IMAGEATLAS_H
+#define IMAGEATLAS_H
+
+#include <QImage>
+#include <QPainter>
+#include <QBuffer>
+#include <QByteArray>
+#include <QString>
+#include <QRect>
+#include <QSet>
+#include <optional>
+#include <vector>
+
+/**
+ * @brief The ImageAtlas class packs small images into atlas pages, elements then refer to
+ * a sub-rectangle of a page. Images are placed on shelves, i.e. rows of images of
+ * about the same height.
+ */
+class ImageAtlas {
+public:
+    static constexpr int PageSize = 1024;
+    static constexpr int ImageMax = 256;    // larger images are not packed
+    static constexpr int Padding = 2;       // avoid bleeding of the neighbours when mipmapped
+
+    struct Placement {
+        int page;
+        QRect rect;
+    };
+
+    static QString fileName(int page) {
+        return QString("atlas_%1.png").arg(page);
+    }
+
+    static bool fits(const QSize& size) {
+        return size.isValid() && size.width() <= ImageMax && size.height() <= ImageMax;
+    }
+
+    std::optional<Placement> add(const QImage& image) {
+        if(image.isNull() || !fits(image.size()))
+            return std::nullopt;
+        const auto placement = place(image.size());
+        auto& page = m_pages[static_cast<size_t>(placement.page)];
+        QPainter painter(&page.image);
+        painter.setCompositionMode(QPainter::CompositionMode_Source);
+        painter.drawImage(placement.rect.topLeft(), image);
+        page.dirty = true;
+        m_used += static_cast<qint64>(image.width()) * image.height();
+        ++m_images;
+        return placement;
+    }
+
+    /**
+     * @brief takeDirty, pages changed since the previous call
+     */
+    QSet<int> takeDirty() {
+        QSet<int> dirty;
+        for(auto i = 0U; i < m_pages.size(); ++i) {
+            if(m_pages[i].dirty)
+                dirty.insert(static_cast<int>(i));
+            m_pages[i].dirty = false;
+        }
+        return dirty;
+    }
+
+    QByteArray encoded(int page) const {
+        QByteArray bytes;
+        QBuffer buffer(&bytes);
+        buffer.open(QIODevice::WriteOnly);
+        m_pages[static_cast<size_t>(page)].image.save(&buffer, "PNG");
+        return bytes;
+    }
+
+    int pages() const {
+        return static_cast<int>(m_pages.size());
+    }
+
+    int images() const {
+        return m_images;
+    }
+
+    /**
+     * @brief fillRate, share of the page area used by the images
+     */
+    double fillRate() const {
+        return m_pages.empty() ? 0. : static_cast<double>(m_used) / (static_cast<double>(PageSize) * PageSize * static_cast<double>(m_pages.size()));
+    }
+private:
+    struct Shelf {
+        int y;
+        int height;
+        int x;
+    };
+    struct Page {
+        QImage image;
+        std::vector<Shelf> shelves;
+        int top = 0;
+        bool dirty = false;
+    };
+
+    Placement place(const QSize& size) {
+        const auto w = size.width() + 2 * Padding;
+        const auto h = size.height() + 2 * Padding;
+        for(auto i = 0U; i < m_pages.size(); ++i) {
+            auto& page = m_pages[i];
+            for(auto& shelf : page.shelves) {
+                // a shelf much higher would waste the space
+                if(shelf.height >= h && shelf.height <= h + h / 2 && shelf.x + w <= PageSize) {
+                    const QRect rect(shelf.x + Padding, shelf.y + Padding, size.width(), size.height());
+                    shelf.x += w;
+                    return {static_cast<int>(i), rect};
+                }
+            }
+            if(page.top + h <= PageSize) {
+                page.shelves.push_back({page.top, h, w});
+                const QRect rect(Padding, page.top + Padding, size.width(), size.height());
+                page.top += h;
+                return {static_cast<int>(i), rect};
+            }
+        }
+        Page page;
+        page.image = QImage(PageSize, PageSize, QImage::Format_ARGB32_Premultiplied);
+        page.image.fill(Qt::transparent);
+        page.shelves.push_back({0, h, w});
+        page.top = h;
+        m_pages.push_back(std::move(page));
+        return {static_cast<int>(m_pages.size() - 1), QRect(Padding, Padding, size.width(), size.height())};
+    }
+private:
+    std::vector<Page> m_pages;
+    qint64 m_used = 0;
+    int m_images = 0;
+};
+
+#endif // IMAGEATLAS_H
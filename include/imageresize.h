@@ -0,0 +1,77 @@
+#ifndef IMAGERESIZE_H
+#define IMAGERESIZE_H
+
+#include <QByteArray>
+#include <QString>
+#include <QSize>
+#include <QBuffer>
+#include <QImage>
+#include <QImageReader>
+#include <QImageWriter>
+#include <QPromise>
+#include <QFuture>
+#if QT_CONFIG(thread)
+#include <QThreadPool>
+#endif
+#include <memory>
+
+/**
+ * @brief ImageResize, downscales encoded images without blocking the caller.
+ */
+namespace ImageResize {
+
+struct Result {
+    QByteArray bytes;
+    QString error; // empty if ok
+};
+
+/**
+ * @brief resize, decodes the image at the reduced size (JPEG uses DCT scaling) and encodes it
+ * in the same format.
+ */
+inline Result resize(const QByteArray& bytes, const QByteArray& format, const QSize& maxSize) {
+    QBuffer input;
+    input.setData(bytes);
+    QImageReader reader(&input, format);
+    reader.setScaledSize(reader.size().scaled(maxSize, Qt::KeepAspectRatio));
+    const auto image = reader.read();
+    if(image.isNull())
+        return {{}, QString("cannot be resized to %1x%2 \"%3\"").arg(maxSize.width()).arg(maxSize.height()).arg(reader.errorString())};
+    QByteArray out;
+    QBuffer buffer(&out);
+    if(!buffer.open(QIODevice::WriteOnly))
+        return {{}, QString("cannot be resized \"%1\"").arg(buffer.errorString())};
+    QImageWriter writer(&buffer, format);
+    if(!writer.write(image))
+        return {{}, QString("cannot be resized \"%1\"").arg(writer.errorString())};
+    buffer.close();
+    return {out, {}};
+}
+
+/**
+ * @brief run, resize in the global thread pool. A resize not yet started is skipped if the future is cancelled.
+ */
+inline QFuture<Result> run(const QByteArray& bytes, const QByteArray& format, const QSize& maxSize) {
+#if QT_CONFIG(thread)
+    auto promise = std::make_shared<QPromise<Result>>();
+    auto future = promise->future();
+    promise->start();
+    QThreadPool::globalInstance()->start([promise, bytes, format, maxSize]() {
+        if(!promise->isCanceled())
+            promise->addResult(resize(bytes, format, maxSize));
+        promise->finish();
+    });
+    return future;
+#else
+    QPromise<Result> promise;
+    auto future = promise.future();
+    promise.start();
+    promise.addResult(resize(bytes, format, maxSize));
+    promise.finish();
+    return future;
+#endif
+}
+
+}
+
+#endif // IMAGERESIZE_H
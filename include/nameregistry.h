@@ -0,0 +1,80 @@
+#ifndef NAMEREGISTRY_H
+#define NAMEREGISTRY_H
+
+#include "figmaparser.h"
+#include <QHash>
+#include <QSet>
+#include <QJsonObject>
+#include <QJsonArray>
+
+/**
+ * @brief The NameRegistry class gives unique file names for the components and elements of a document.
+ *
+ * Names are given when the document is indexed, in the order of the document, thus the same
+ * document always gets the same names. Once indexed, the registry is only read and
+ * can be used from concurrent parsers without locking.
+ */
+class NameRegistry {
+public:
+    /**
+     * @brief index components and elements (views) of the document
+     */
+    void index(const QJsonObject& project) {
+        clear();
+        const auto components = project["components"].toObject();
+        for(auto it = components.begin(); it != components.end(); ++it)    // keys are sorted
+            insert(it.key(), it.value().toObject()["name"].toString());
+        const auto canvases = project["document"].toObject()["children"].toArray();
+        for(const auto& c : canvases) {
+            const auto elements = c.toObject()["children"].toArray();
+            for(const auto& e : elements) {
+                const auto element = e.toObject();
+                insert(element["id"].toString(), element["name"].toString());
+            }
+        }
+    }
+
+    /**
+     * @brief name of node
+     * @param id - figma id
+     * @param name - figma name, used only if node is not indexed
+     */
+    QString name(const QString& id, const QString& name) const {
+        const auto it = m_names.constFind(id);
+        if(it != m_names.constEnd())
+            return *it;
+        // not indexed, the id keeps it unique
+        return name.isEmpty() ? QString() : FigmaParser::makeFileName(name + '_' + id + FIGMA_SUFFIX);
+    }
+
+    void clear() {
+        m_names.clear();
+        m_used.clear();
+        m_counts.clear();
+    }
+private:
+    void insert(const QString& id, const QString& name) {
+        if(m_names.contains(id))
+            return;
+        if(name.isEmpty()) {
+            m_names.insert(id, QString());
+            return;
+        }
+        auto& count = m_counts[name];
+        for(;;) {
+            const auto unique = FigmaParser::makeFileName((count > 0 ? name + QString::number(count) : name) + FIGMA_SUFFIX);
+            ++count;
+            if(!m_used.contains(unique)) {
+                m_used.insert(unique);
+                m_names.insert(id, unique);
+                return;
+            }
+        }
+    }
+private:
+    QHash<QString, QString> m_names; // id -> name
+    QSet<QString> m_used;
+    QHash<QString, int> m_counts;
+};
+
+#endif // NAMEREGISTRY_H
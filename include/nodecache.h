@@ -0,0 +1,337 @@
+#ifndef NODECACHE_H
+#define NODECACHE_H
+
+#include "figmaparser.h"
+#include <QHash>
+#include <QSet>
+#include <QCryptographicHash>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QDataStream>
+#include <QSaveFile>
+#include <QFile>
+#include <QDir>
+#include <QDateTime>
+#include <memory>
+#include <functional>
+#include <cstring>
+
+/**
+ * @brief The NodeCache class keeps the generated elements and components of the previous
+ * document generations, so unchanged nodes are not parsed again when the document is updated
+ * or the same settings are applied again.
+ *
+ * A cached node is reused only if its subtree hash is unchanged, the fonts it used resolve
+ * the same way and none of the components it instantiates (transitively) has changed.
+ *
+ * If a directory is set, the nodes are also stored on the disk and are available
+ * for the next runs. The least recently used nodes are removed when the disk usage exceeds DiskLimit.
+ */
+class NodeCache {
+public:
+    struct Stats {
+        int rebuilt = 0;
+        int reused = 0;
+    };
+    using Fonts = QHash<QString, QString>; // requested -> resolved
+    using Accept = std::function<bool (const FigmaParser::Element&)>;
+    using FontResolver = std::function<QString (const QString&)>;
+private:
+    struct Entry {
+        QByteArray hash;
+        unsigned revision;
+        QHash<QString, QByteArray> dependencies; // component id -> component hash when generated
+        Fonts fonts;
+        std::shared_ptr<const FigmaParser::Element> element;
+    };
+    using Entries = QHash<QString, Entry>;
+    struct Generation {
+        Entries components;
+        Entries elements;
+    };
+    static constexpr int MaxGenerations = 8; // each set of flags, imports etc. has an own generation
+    static constexpr char StreamId[] = "FQNC";
+    static constexpr int StreamVersion = 1;
+    static constexpr qint64 DiskLimit = 256 * 1024 * 1024; // least recently used nodes are removed above this
+    static constexpr char VersionFile[] = "version";
+public:
+    static QByteArray hash(const QJsonObject& obj) {
+        return QCryptographicHash::hash(QJsonDocument(obj).toJson(QJsonDocument::Compact), QCryptographicHash::Md5);
+    }
+
+    /**
+     * @brief setDirectory, where nodes are persisted, if empty nodes are kept only in memory
+     */
+    void setDirectory(const QString& directory) {
+        m_directory = directory;
+        if(m_directory.isEmpty())
+            return;
+        // nodes of an other version are not readable
+        QDir dir(m_directory);
+        QFile version(dir.filePath(VersionFile));
+        if(!version.open(QIODevice::ReadOnly) || version.readAll().toInt() != StreamVersion) {
+            version.close();
+            dir.removeRecursively();
+            if(!QDir().mkpath(m_directory))
+                return;
+            QSaveFile file(dir.filePath(VersionFile));
+            if(file.open(QIODevice::WriteOnly) && file.write(QByteArray::number(StreamVersion)) > 0)
+                file.commit();
+        }
+        prune();
+    }
+
+    void setFontResolver(const FontResolver& resolver) {
+        m_fontResolver = resolver;
+    }
+
+    /**
+     * @brief begin a document generation
+     * @param context - identifies the generation settings (flags, header etc.), nodes are shared only within the same context
+     * @param components - components of the document to be generated
+     */
+    void begin(const QByteArray& context, const FigmaParser::Components& components) {
+        select(context);
+
+        // component name is part of its identity as elements refer components by name
+        m_componentHashes.clear();
+        for(const auto& [id, c] : components.asKeyValueRange())
+            m_componentHashes.insert(id, hash(c->object()) + c->name().toUtf8());
+
+        m_componentStats = {};
+        m_elementStats = {};
+    }
+
+    const QByteArray& context() const {return m_context;}
+    const QHash<QString, QByteArray>& componentHashes() const {return m_componentHashes;}
+
+    /**
+     * @brief restore the context and component hashes of an earlier begin, e.g. to generate its
+     * elements later. Stats are not reset.
+     */
+    void restore(const QByteArray& context, const QHash<QString, QByteArray>& componentHashes) {
+        if(context.isEmpty()) {
+            m_context.clear();
+            m_current = nullptr;
+        } else {
+            select(context);
+        }
+        m_componentHashes = componentHashes;
+    }
+
+    /**
+     * @brief nextRevision, called when a new document is requested. Nodes generated
+     * after this are counted as rebuilt even if the document generation is retried.
+     */
+    void nextRevision() {
+        ++m_revision;
+    }
+
+    std::shared_ptr<const FigmaParser::Element> component(const QString& id, const QByteArray& hash, const Accept& accept) {
+        return find(m_current->components, m_componentStats, 'c', id, hash, accept);
+    }
+
+    std::shared_ptr<const FigmaParser::Element> element(const QString& id, const QByteArray& hash, const Accept& accept) {
+        return find(m_current->elements, m_elementStats, 'e', id, hash, accept);
+    }
+
+    void insertComponent(const QString& id, const QByteArray& hash, const FigmaParser::Element& element, const Fonts& fonts) {
+        insert(m_current->components, 'c', id, hash, element, fonts);
+        ++m_componentStats.rebuilt;
+    }
+
+    void insertElement(const QString& id, const QByteArray& hash, const FigmaParser::Element& element, const Fonts& fonts) {
+        insert(m_current->elements, 'e', id, hash, element, fonts);
+        ++m_elementStats.rebuilt;
+    }
+
+    /**
+     * @brief release an element from the memory, it is still available from the disk
+     */
+    void releaseElement(const QString& id) {
+        if(m_current)
+            m_current->elements.remove(id);
+    }
+
+    const Stats& componentStats() const {return m_componentStats;}
+    const Stats& elementStats() const {return m_elementStats;}
+
+    /**
+     * @brief clear memory, the disk cache is not touched
+     */
+    void clear() {
+        m_generations.clear();
+        m_order.clear();
+        m_componentHashes.clear();
+        m_current = nullptr;
+    }
+private:
+    // remove the least recently used files above the DiskLimit
+    void prune() {
+        m_written = 0;
+        const auto entries = QDir(m_directory).entryInfoList(QDir::Files, QDir::Time);
+        qint64 size = 0;
+        for(const auto& entry : entries) {
+            if(entry.fileName() == QLatin1String(VersionFile))
+                continue;
+            size += entry.size();
+            if(size > DiskLimit)
+                QFile::remove(entry.absoluteFilePath());
+        }
+    }
+
+    void select(const QByteArray& context) {
+        if(!m_generations.contains(context)) {
+            if(m_order.size() >= MaxGenerations)
+                m_generations.remove(m_order.takeFirst());
+            m_generations.insert(context, {});
+        } else {
+            m_order.removeOne(context);
+        }
+        m_order.append(context);
+        m_context = context;
+        m_current = &m_generations[context];
+    }
+
+    void insert(Entries& entries, char kind, const QString& id, const QByteArray& hash, const FigmaParser::Element& element, const Fonts& fonts) {
+        QHash<QString, QByteArray> dependencies;
+        for(const auto& c : element.components())
+            dependencies.insert(c, m_componentHashes.value(c));
+        const auto& entry = *entries.insert(id, {hash, m_revision, std::move(dependencies), fonts, std::make_shared<const FigmaParser::Element>(element)});
+        if(!m_directory.isEmpty())
+            store(fileName(kind, id, hash), entry);
+    }
+
+    bool isValid(const Entry& entry, QSet<QString>& visited) const {
+        if(m_fontResolver) {
+            for(const auto& [requested, resolved] : entry.fonts.asKeyValueRange())
+                if(m_fontResolver(requested) != resolved)
+                    return false;
+        }
+        for(const auto& [id, h] : entry.dependencies.asKeyValueRange()) {
+            if(m_componentHashes.value(id) != h)
+                return false;
+            if(visited.contains(id))
+                continue;
+            visited.insert(id);
+            const auto it = m_current->components.find(id);
+            if(it != m_current->components.end() && !isValid(*it, visited))
+                return false;
+        }
+        return true;
+    }
+
+    std::shared_ptr<const FigmaParser::Element> find(Entries& entries, Stats& stats, char kind, const QString& id, const QByteArray& hash, const Accept& accept) {
+        Q_ASSERT(m_current);
+        auto it = entries.find(id);
+        if(it == entries.end() || it->hash != hash) {
+            auto entry = load(fileName(kind, id, hash));
+            if(!entry || entry->hash != hash)
+                return nullptr;
+            it = entries.insert(id, std::move(*entry));
+        }
+        QSet<QString> visited;
+        if(!isValid(*it, visited) || (accept && !accept(*it->element)))
+            return nullptr;
+        if(it->revision == m_revision)
+            ++stats.rebuilt; // generated during this revision, before the generation was suspended
+        else
+            ++stats.reused;
+        return it->element;
+    }
+
+    QString fileName(char kind, const QString& id, const QByteArray& hash) const {
+        if(m_directory.isEmpty())
+            return QString();
+        const auto key = QCryptographicHash::hash(m_context + kind + id.toUtf8() + hash, QCryptographicHash::Md5);
+        return m_directory + '/' + key.toHex();
+    }
+
+    void store(const QString& fileName, const Entry& entry) {
+        if(!QDir().mkpath(m_directory))
+            return;
+        QSaveFile file(fileName);
+        if(!file.open(QIODevice::WriteOnly))
+            return;
+        QDataStream stream(&file);
+        const auto& e = *entry.element;
+        stream.writeRawData(StreamId, 4);
+        stream << StreamVersion << entry.hash << entry.dependencies << entry.fonts;
+        stream << e.name() << e.id() << e.type() << e.data() << e.components() << e.imageContexts() << e.aliases();
+        stream << static_cast<int>(e.subComponents().size());
+        for(const auto& [name, sub] : e.subComponents().asKeyValueRange())
+            stream << name << std::get<QJsonObject>(sub) << std::get<QByteArray>(sub);
+        stream << static_cast<int>(e.externalLoaders().size());
+        for(const auto& [loaderId, loader] : e.externalLoaders().asKeyValueRange())
+            stream << loaderId << std::get<QByteArray>(loader) << std::get<QString>(loader);
+        if(stream.status() != QDataStream::Ok)
+            file.cancelWriting();
+        const auto size = file.pos();
+        if(file.commit())
+            m_written += size;
+        if(m_written > DiskLimit / 4)
+            prune();
+    }
+
+    std::optional<Entry> load(const QString& fileName) const {
+        if(fileName.isEmpty())
+            return std::nullopt;
+        QFile file(fileName);
+        if(!file.open(QIODevice::ReadOnly))
+            return std::nullopt;
+        QDataStream stream(&file);
+        char id[4];
+        if(stream.readRawData(id, 4) != 4 || memcmp(id, StreamId, 4) != 0)
+            return std::nullopt;
+        int version;
+        stream >> version;
+        if(version != StreamVersion)
+            return std::nullopt;
+        Entry entry;
+        entry.revision = 0;
+        stream >> entry.hash >> entry.dependencies >> entry.fonts;
+        QString name, elementId, type;
+        QByteArray data;
+        QStringList components, contexts;
+        QVector<QString> aliases;
+        stream >> name >> elementId >> type >> data >> components >> contexts >> aliases;
+        int count;
+        stream >> count;
+        FigmaParser::ComponentStreams subComponents;
+        for(int i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+            QByteArray subName, subData;
+            QJsonObject subObject;
+            stream >> subName >> subObject >> subData;
+            subComponents.insert(subName, std::make_tuple(subObject, subData));
+        }
+        stream >> count;
+        FigmaParser::ExternalLoaders externalLoaders;
+        for(int i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+            QString loaderId, loaderName;
+            QByteArray loaderData;
+            stream >> loaderId >> loaderData >> loaderName;
+            externalLoaders.insert(loaderId, std::make_tuple(loaderData, loaderName));
+        }
+        if(stream.status() != QDataStream::Ok)
+            return std::nullopt;
+        file.setFileTime(QDateTime::currentDateTime(), QFileDevice::FileModificationTime); // recently used
+        entry.element = std::make_shared<const FigmaParser::Element>(name, elementId, type,
+                                                                     std::move(data), std::move(components), std::move(contexts), std::move(aliases),
+                                                                     subComponents, externalLoaders);
+        return entry;
+    }
+private:
+    QHash<QByteArray, Generation> m_generations;
+    QList<QByteArray> m_order;
+    QByteArray m_context;
+    Generation* m_current = nullptr;
+    QHash<QString, QByteArray> m_componentHashes;
+    Stats m_componentStats;
+    Stats m_elementStats;
+    unsigned m_revision = 0;
+    QString m_directory;
+    qint64 m_written = 0; // bytes stored since the previous prune
+    FontResolver m_fontResolver = nullptr;
+};
+
+#endif // NODECACHE_H
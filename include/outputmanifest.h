@@ -0,0 +1,169 @@
+#ifndef OUTPUTMANIFEST_H
+#define OUTPUTMANIFEST_H
+
+#include "contenthash.h"
+#include "outputwriter.h"
+#include <QHash>
+#include <QDateTime>
+#include <QDataStream>
+#include <QSaveFile>
+#include <QFileInfo>
+#include <QFile>
+#include <QDir>
+#include <QStandardPaths>
+#include <cstring>
+
+/**
+ * @brief The OutputManifest class keeps the content hashes of the written files, so a file
+ * is not rewritten if its content is not changed. Unchanged files keep their modification time
+ * and the tools depending on them (qmlcachegen, CMake etc.) do not need to rebuild.
+ *
+ * If a directory is given, the manifest of the directory is stored into the cache location and is available
+ * for the next runs. Nothing is added into the directory itself.
+ */
+class OutputManifest {
+public:
+    enum class Write {Error, Unchanged, Created, Changed};
+private:
+    struct Entry {
+        quint64 hash;
+        qint64 size;
+        qint64 modified;
+    };
+    static constexpr auto ManifestPath = "/manifests/";
+    static constexpr char StreamId[] = "FQOM";
+    static constexpr int StreamVersion = 1;
+public:
+    /**
+     * @brief OutputManifest
+     * @param directory - the files written there are recorded, if empty manifest is kept only in memory
+     */
+    explicit OutputManifest(const QString& directory = QString()) : m_directory(directory) {
+        load();
+    }
+
+    /**
+     * @brief write data to a file, unless the file already has the same content
+     * @param writer - if set, file is written on the background and is recorded when the manifest is saved
+     */
+    Write write(const QString& fileName, const QByteArray& data, OutputWriter* writer = nullptr) {
+        const auto hash = hash64(data);
+        const QFileInfo info(fileName);
+        if(info.exists()) {
+            if(isSame(info, hash, data.size()))
+                return Write::Unchanged;
+        }
+        if(writer) {
+            writer->write(fileName, data, OutputWriter::Mode::Durable);
+            m_pending.insert(fileName, {hash, data.size()});
+            return info.exists() ? Write::Changed : Write::Created;
+        }
+        if(!QDir().mkpath(info.absolutePath())) {
+            m_errorString = QString("Cannot create folder %1").arg(info.absolutePath());
+            return Write::Error;
+        }
+        QSaveFile file(fileName);
+        if(!file.open(QIODevice::WriteOnly) || file.write(data) != data.size() || !file.commit()) {
+            m_errorString = file.errorString();
+            return Write::Error;
+        }
+        insert(QFileInfo(fileName), hash);
+        return info.exists() ? Write::Changed : Write::Created;
+    }
+
+    /**
+     * @brief errorString of the latest failed write
+     */
+    QString errorString() const {
+        return m_errorString;
+    }
+
+    /**
+     * @brief save the manifest, no-op if there is no directory. Background writes have to be flushed before.
+     */
+    bool save() {
+        for(const auto& [fileName, pending] : m_pending.asKeyValueRange()) {
+            const QFileInfo info(fileName);
+            if(info.exists() && info.size() == pending.second) // else write has failed
+                insert(info, pending.first);
+        }
+        m_pending.clear();
+        if(m_directory.isEmpty())
+            return true;
+        if(!QDir().mkpath(QFileInfo(manifestFile()).absolutePath()))
+            return false;
+        QSaveFile file(manifestFile());
+        if(!file.open(QIODevice::WriteOnly))
+            return false;
+        QDataStream stream(&file);
+        stream.writeRawData(StreamId, 4);
+        stream << StreamVersion << static_cast<int>(m_entries.size());
+        for(const auto& [name, e] : m_entries.asKeyValueRange())
+            stream << name << e.hash << e.size << e.modified;
+        if(stream.status() != QDataStream::Ok) {
+            file.cancelWriting();
+            return false;
+        }
+        return file.commit();
+    }
+private:
+    bool isSame(const QFileInfo& info, quint64 hash, qint64 size) {
+        if(info.size() != size)
+            return false;
+        const auto it = m_entries.constFind(key(info));
+        if(it != m_entries.constEnd() && it->size == size && it->modified == info.lastModified().toMSecsSinceEpoch())
+            return it->hash == hash;
+        // not known or touched by someone else, compare the content
+        QFile file(info.absoluteFilePath());
+        if(!file.open(QIODevice::ReadOnly) || hash64(file.readAll()) != hash)
+            return false;
+        insert(info, hash);
+        return true;
+    }
+
+    void insert(const QFileInfo& info, quint64 hash) {
+        m_entries.insert(key(info), {hash, info.size(), info.lastModified().toMSecsSinceEpoch()});
+    }
+
+    QString key(const QFileInfo& info) const {
+        return m_directory.isEmpty() ? info.absoluteFilePath() : QDir(m_directory).relativeFilePath(info.absoluteFilePath());
+    }
+
+    // one manifest per directory
+    QString manifestFile() const {
+        return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + ManifestPath
+                + QString::number(hash64(QDir(m_directory).absolutePath().toUtf8()), 16);
+    }
+
+    void load() {
+        if(m_directory.isEmpty())
+            return;
+        QFile file(manifestFile());
+        if(!file.open(QIODevice::ReadOnly))
+            return;
+        QDataStream stream(&file);
+        char id[4];
+        if(stream.readRawData(id, 4) != 4 || memcmp(id, StreamId, 4) != 0)
+            return;
+        int version, count;
+        stream >> version;
+        if(version != StreamVersion)
+            return;
+        stream >> count;
+        for(int i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+            QString name;
+            Entry e;
+            stream >> name >> e.hash >> e.size >> e.modified;
+            m_entries.insert(name, e);
+        }
+        if(stream.status() != QDataStream::Ok)
+            m_entries.clear();
+    }
+private:
+    QString m_directory;
+    QHash<QString, Entry> m_entries;
+    QHash<QString, std::pair<quint64, qint64>> m_pending; // file name -> hash, size
+    QString m_errorString;
+};
+
+#endif // OUTPUTMANIFEST_H
@@ -0,0 +1,212 @@
+#ifndef OUTPUTWRITER_H
+#define OUTPUTWRITER_H
+
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QMap>
+#include <QSet>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QWaitCondition>
+#include <QThread>
+#include <QPromise>
+#include <QFuture>
+#include <QSaveFile>
+#include <QFileInfo>
+#include <QFile>
+#include <QDir>
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <vector>
+
+/**
+ * @brief The OutputWriter class writes files on the background, so the generation does not wait the disk.
+ *
+ * Writes are queued into a bounded queue, if the queue is full the caller waits (there is only so much
+ * memory to spend for pending data). Each folder is created only once. Errors are collected in the order
+ * the writes were requested and are returned by flush, that has to be called before the written files are used.
+ * Writes into the same file are done one at the time in the requested order, so the latest data remains.
+ * Writes not yet started can be cancelled.
+ *
+ * Without thread support files are written immediately.
+ */
+class OutputWriter {
+public:
+    enum class Mode {
+        Scratch,  // temporary output, not synced to the disk
+        Durable   // synced to the disk on commit
+    };
+private:
+    struct Job {
+        quint64 sequence = 0;
+        QString fileName;
+        QByteArray data;
+        Mode mode = Mode::Scratch;
+        QPromise<bool> promise;
+    };
+    static constexpr std::size_t QueueCapacity = 256;
+public:
+    explicit OutputWriter(int workers = std::max(2, QThread::idealThreadCount() / 2)) {
+#if QT_CONFIG(thread)
+        for(int i = 0; i < workers; ++i) {
+            m_workers.emplace_back(QThread::create([this]() {run();}));
+            m_workers.back()->start();
+        }
+#else
+        Q_UNUSED(workers);
+#endif
+    }
+
+    ~OutputWriter() {
+        {
+            QMutexLocker lock(&m_mutex);
+            m_stop = true;
+            m_hasJobs.wakeAll();
+        }
+        for(auto& w : m_workers)
+            w->wait(); // pending jobs are written before workers exit
+    }
+
+    /**
+     * @brief write data into a file
+     * @return future that is true when the file is successfully written
+     */
+    QFuture<bool> write(const QString& fileName, const QByteArray& data, Mode mode = Mode::Scratch) {
+        Job job{0, fileName, data, mode, {}};
+        job.promise.start();
+        auto future = job.promise.future();
+        QMutexLocker lock(&m_mutex);
+        job.sequence = ++m_sequence;
+        if(m_workers.empty()) {
+            lock.unlock();
+            complete(job);
+            return future;
+        }
+        while(m_jobs.size() >= QueueCapacity)
+            m_hasRoom.wait(&m_mutex);
+        ++m_pending;
+        m_jobs.push_back(std::move(job));
+        m_hasJobs.wakeOne();
+        return future;
+    }
+
+    /**
+     * @brief flush, wait until all requested writes are done
+     * @return errors of the writes since the previous flush, in the order writes were requested
+     */
+    QStringList flush() {
+        QMutexLocker lock(&m_mutex);
+        while(m_pending > 0)
+            m_idle.wait(&m_mutex);
+        const auto errors = m_errors.values();
+        m_errors.clear();
+        QMutexLocker folderLock(&m_folderMutex);
+        m_folders.clear(); // folders may be removed after this
+        return errors;
+    }
+
+    /**
+     * @brief cancel the writes that are not yet started
+     * @return names of the files that are not written
+     */
+    QStringList cancel() {
+        QMutexLocker lock(&m_mutex);
+        QStringList dropped;
+        for(auto& job : m_jobs) {
+            dropped.append(job.fileName);
+            job.promise.addResult(false);
+            job.promise.finish();
+        }
+        m_pending -= static_cast<int>(m_jobs.size());
+        m_jobs.clear();
+        m_hasRoom.wakeAll();
+        if(m_pending == 0)
+            m_idle.wakeAll();
+        return dropped;
+    }
+
+private:
+    void run() {
+        for(;;) {
+            Job job;
+            {
+                QMutexLocker lock(&m_mutex);
+                auto next = m_jobs.end();
+                for(;;) {
+                    // the oldest job of a file that is not being written
+                    next = std::find_if(m_jobs.begin(), m_jobs.end(), [this](const Job& j) {return !m_active.contains(j.fileName);});
+                    if(next != m_jobs.end() || (m_stop && m_jobs.empty()))
+                        break;
+                    m_hasJobs.wait(&m_mutex);
+                }
+                if(next == m_jobs.end())
+                    return;
+                job = std::move(*next);
+                m_jobs.erase(next);
+                m_active.insert(job.fileName);
+                m_hasRoom.wakeOne();
+            }
+            complete(job);
+            QMutexLocker lock(&m_mutex);
+            m_active.remove(job.fileName);
+            m_hasJobs.wakeAll(); // a write of the same file may wait
+            if(--m_pending == 0)
+                m_idle.wakeAll();
+        }
+    }
+
+    void complete(Job& job) {
+        const auto error = store(job);
+        if(!error.isEmpty()) {
+            QMutexLocker lock(&m_mutex);
+            m_errors.insert(job.sequence, error);
+        }
+        job.promise.addResult(error.isEmpty());
+        job.promise.finish();
+    }
+
+    QString store(const Job& job) {
+        const auto folder = QFileInfo(job.fileName).absolutePath();
+        if(!ensureFolder(folder))
+            return QString("Cannot create folder %1").arg(folder);
+        if(job.mode == Mode::Durable) {
+            QSaveFile file(job.fileName);
+            if(!file.open(QIODevice::WriteOnly) || file.write(job.data) != job.data.size() || !file.commit())
+                return QString("Cannot write %1 %2").arg(job.fileName, file.errorString());
+        } else {
+            QFile::remove(job.fileName); // a new file, as the old one may be linked elsewhere
+            QFile file(job.fileName);
+            if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(job.data) != job.data.size())
+                return QString("Cannot write %1 %2").arg(job.fileName, file.errorString());
+        }
+        return QString();
+    }
+
+    bool ensureFolder(const QString& folder) {
+        QMutexLocker lock(&m_folderMutex);
+        if(m_folders.contains(folder))
+            return true;
+        if(!QDir().mkpath(folder))
+            return false;
+        m_folders.insert(folder);
+        return true;
+    }
+private:
+    QMutex m_mutex;
+    QWaitCondition m_hasJobs;
+    QWaitCondition m_hasRoom;
+    QWaitCondition m_idle;
+    std::deque<Job> m_jobs;
+    QSet<QString> m_active; // files being written
+    QMap<quint64, QString> m_errors; // sequence -> error
+    quint64 m_sequence = 0;
+    int m_pending = 0;
+    bool m_stop = false;
+    QMutex m_folderMutex;
+    QSet<QString> m_folders;
+    std::vector<std::unique_ptr<QThread>> m_workers;
+};
+
+#endif // OUTPUTWRITER_H
@@ -0,0 +1,72 @@
+#ifndef QMLSTORE_H
+#define QMLSTORE_H
+
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QUrl>
+#include <QString>
+#include <QByteArray>
+#include <optional>
+
+/**
+ * @brief The QmlStore class keeps the QML sources of the viewed document in the memory. They are
+ * served to the QML engine using the "figmaqml" URL scheme, hence viewing does not touch the file system.
+ *
+ * QML engine reads the store from its loader threads.
+ */
+class QmlStore {
+public:
+    static constexpr auto Scheme = "figmaqml";
+    static constexpr auto Folder = "/qml/";
+
+    static QUrl url(const QString& fileName) {
+        return QUrl(QString("%1:%2%3").arg(Scheme, Folder, fileName));
+    }
+
+    void insert(const QString& fileName, const QByteArray& data) {
+        QMutexLocker lock(&m_mutex);
+        m_sources.insert(fileName, data);
+    }
+
+    void remove(const QString& fileName) {
+        QMutexLocker lock(&m_mutex);
+        m_sources.remove(fileName);
+    }
+
+    void clear() {
+        QMutexLocker lock(&m_mutex);
+        m_sources.clear();
+    }
+
+    /**
+     * @brief value, source of url. As remote folders are not listed by QML engine, a qmldir
+     * is generated to make the components visible.
+     */
+    std::optional<QByteArray> value(const QUrl& url) const {
+        if(url.scheme() != QLatin1String(Scheme) || !url.path().startsWith(QLatin1String(Folder)))
+            return std::nullopt;
+        const auto fileName = url.path().mid(QLatin1String(Folder).size());
+        QMutexLocker lock(&m_mutex);
+        if(fileName == QLatin1String("qmldir"))
+            return qmldir();
+        const auto it = m_sources.constFind(fileName);
+        if(it == m_sources.constEnd())
+            return std::nullopt;
+        return *it;
+    }
+private:
+    QByteArray qmldir() const {
+        QByteArray dir;
+        for(const auto& fileName : m_sources.keys()) {
+            if(fileName.endsWith(QLatin1String(".qml")) && !fileName.isEmpty() && fileName[0].isUpper())
+                dir += QString("%1 1.0 %2\n").arg(fileName.chopped(4), fileName).toUtf8();
+        }
+        return dir;
+    }
+private:
+    mutable QMutex m_mutex;
+    QHash<QString, QByteArray> m_sources; // file name -> data
+};
+
+#endif // QMLSTORE_H
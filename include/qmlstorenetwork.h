@@ -0,0 +1,53 @@
+#ifndef QMLSTORENETWORK_H
+#define QMLSTORENETWORK_H
+
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QQmlNetworkAccessManagerFactory>
+#include <memory>
+#include <optional>
+
+class QmlStore;
+
+/**
+ * @brief The QmlStoreReply class, a reply that reads the QML source from the memory
+ */
+class QmlStoreReply : public QNetworkReply {
+    Q_OBJECT
+public:
+    QmlStoreReply(const QNetworkRequest& request, const std::optional<QByteArray>& data, QObject* parent);
+    void abort() override;
+    qint64 bytesAvailable() const override;
+    bool isSequential() const override;
+protected:
+    qint64 readData(char* data, qint64 maxSize) override;
+private:
+    const QByteArray m_data;
+    qint64 m_offset = 0;
+};
+
+/**
+ * @brief The QmlStoreAccessManager class serves the QmlStore URLs, other requests are passed as is
+ */
+class QmlStoreAccessManager : public QNetworkAccessManager {
+    Q_OBJECT
+public:
+    QmlStoreAccessManager(const std::shared_ptr<const QmlStore>& store, QObject* parent);
+protected:
+    QNetworkReply* createRequest(Operation op, const QNetworkRequest& request, QIODevice* outgoingData) override;
+private:
+    std::shared_ptr<const QmlStore> m_store;
+};
+
+/**
+ * @brief The QmlStoreFactory class, set to the QML engine to view QML from the QmlStore
+ */
+class QmlStoreFactory : public QQmlNetworkAccessManagerFactory {
+public:
+    explicit QmlStoreFactory(const std::shared_ptr<const QmlStore>& store);
+    QNetworkAccessManager* create(QObject* parent) override;
+private:
+    std::shared_ptr<const QmlStore> m_store;
+};
+
+#endif // QMLSTORENETWORK_H
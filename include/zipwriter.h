@@ -0,0 +1,69 @@
+#ifndef ZIPWRITER_H
+#define ZIPWRITER_H
+
+#include <QIODevice>
+#include <QFileDevice>
+#include <QString>
+#include <QByteArray>
+#include <quazip/quazip.h>
+#include <quazip/quazipfile.h>
+#include <quazip/quazipnewinfo.h>
+#include <zlib.h>
+
+/**
+ * @brief The ZipWriter class writes entries into a zip archive as they are added, there is no
+ * intermediate files. The device can be sequential (e.g. stdout).
+ */
+class ZipWriter {
+public:
+    enum class Method {
+        Compress,
+        Store       // for data that is already compressed, e.g. images
+    };
+
+    /**
+     * @brief ZipWriter
+     * @param device - opened for writing, the caller owns and closes it
+     */
+    explicit ZipWriter(QIODevice* device) : m_zip(device) {
+        m_zip.setAutoClose(false);
+        m_zip.open(QuaZip::mdCreate);
+    }
+
+    ~ZipWriter() {
+        if(m_zip.isOpen())
+            m_zip.close();
+    }
+
+    bool isOpen() const {
+        return m_zip.isOpen();
+    }
+
+    bool add(const QString& name, const QByteArray& data, Method method) {
+        QuaZipNewInfo info(name);
+        info.setPermissions(QFileDevice::ReadOwner | QFileDevice::WriteOwner | QFileDevice::ReadGroup | QFileDevice::ReadOther);
+        QuaZipFile file(&m_zip);
+        const bool store = method == Method::Store;
+        if(!file.open(QIODevice::WriteOnly, info, nullptr, 0, store ? 0 : Z_DEFLATED, store ? 0 : Z_DEFAULT_COMPRESSION))
+            return false;
+        const bool ok = file.write(data) == data.size();
+        file.close();
+        return ok && file.getZipError() == UNZ_OK;
+    }
+
+    /**
+     * @brief close, writes the central directory
+     */
+    bool close() {
+        m_zip.close();
+        return m_zip.getZipError() == UNZ_OK;
+    }
+
+    int error() const {
+        return m_zip.getZipError();
+    }
+private:
+    QuaZip m_zip;
+};
+
+#endif // ZIPWRITER_H
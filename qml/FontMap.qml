@@ -35,6 +35,13 @@ Dialog {
             fontPathInfo.informativeText = _currentfontName + "\nis at:\n" + fontPath;
             fontPathInfo.open();
         }
+        function onFontPathsFound(fontPaths) {
+            let info = "";
+            for(const family in fontPaths)
+                info += family + ":\n" + fontPaths[family] + "\n";
+            fontPathInfo.informativeText = info;
+            fontPathInfo.open();
+        }
         function onFontPathError(error) {
             fontPathInfo.informativeText = _currentfontName + "\nquery error:\n" + error;
             fontPathInfo.open();
@@ -69,6 +76,15 @@ Dialog {
             text: "import font"
             onClicked: figmaQml.importFontFolder()
         }
+        Button {
+            visible: figmaQml.hasFontPathInfo() && fonts.length > 0
+            Layout.alignment: Qt.AlignRight
+            text: "Find all paths"
+            onClicked: {
+                _currentfontName = "";
+                figmaQml.findFontPaths(main.fonts.map(key => main.model[key]));
+            }
+        }
         Label {
             id: placeHolder
             visible: fonts.length === 0
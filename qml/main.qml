@@ -436,6 +436,17 @@ ApplicationWindow {
                                     figmaQml.flags &= ~FigmaQml.RenderLoaderPlaceHolders
                             }
                         }
+                        QtCheckBox {
+                            text: "Preconvert images"
+                            visible: has_qul
+                            checked: figmaQml.flags & FigmaQml.QulPreconvertImages
+                            onCheckedChanged: {
+                                if(checked)
+                                    figmaQml.flags |= FigmaQml.QulPreconvertImages
+                                else
+                                    figmaQml.flags &= ~FigmaQml.QulPreconvertImages
+                            }
+                        }
                         Repeater {
                             model:  [
                                /* {"Shapes":  FigmaQml.PrerenderShapes},
@@ -964,6 +975,7 @@ ApplicationWindow {
         property string key
         function request(fontKey, family) {
             key = fontKey;
+            figmaQml.registerFolderFonts(); // listed in the dialog
             currentFont.family = family;
             open();
         }
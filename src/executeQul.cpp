@@ -115,7 +115,7 @@ bool AppWrite::executeQulApp(const QVariantMap& parameters, const FigmaQml& figm
 
     QTemporaryDir dir;
     VERIFY(dir.isValid(), "Cannot create temp dir")
-    if(!AppWrite::writeQul(dir.path(), figmaQml, true, elements))
+    if(!AppWrite::writeQul(dir.path(), figmaQml, true, elements, parameters["qulPreconvertImages"].toBool()))
         return false;
 
     QProcess build_process;
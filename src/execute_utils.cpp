@@ -7,6 +7,7 @@
 #include <QDirIterator>
 #include <QSet>
 #include "figmaqml.h"
+#include "outputmanifest.h"
 
 
 [[maybe_unused]]
@@ -88,7 +89,7 @@ QStringList ExecuteUtils::qq(const QStringList& str) {
 }
 
 
-std::optional<std::tuple<QStringList, QSet<QString>>> ExecuteUtils::writeElement(const QString& path, const QString& main_file_name, const FigmaQml& figmaQml, const std::pair<int, int>& indices) {
+std::optional<std::tuple<QStringList, QSet<QString>>> ExecuteUtils::writeElement(const QString& path, const QString& main_file_name, const FigmaQml& figmaQml, const std::pair<int, int>& indices, OutputManifest& manifest) {
 
     QStringList qml_files;
     QSet<QString> save_image_filter;
@@ -99,32 +100,20 @@ std::optional<std::tuple<QStringList, QSet<QString>>> ExecuteUtils::writeElement
     const auto bytes = figmaQml.sourceCode(indices.first, indices.second);
     VERIFO(!bytes.isEmpty(), "Cannot find data for " + main_file_name);
 
-    figmaQml.testFileExists(fullname, bytes);
-    QFile qml_out(fullname);
-    VERIFO(qml_out.open(QFile::WriteOnly), "Cannot write a QtQuick file");
-
-    qml_out.write(bytes);
-
-    qml_out.close();
+    VERIFO((manifest.write(fullname, bytes) != OutputManifest::Write::Error), "Cannot write a QtQuick file " + manifest.errorString());
 
     for(const auto& component_name : figmaQml.components(indices.first, indices.second)) {
         save_image_filter.insert(component_name);
         const auto file_name = QML_PREFIX + FigmaQml::validFileName(component_name) + QML_EXT;
         const auto component_src = figmaQml.componentSourceCode(component_name);
         Q_ASSERT(!component_src.isEmpty());
-        figmaQml.testFileExists(file_name, component_src);
         qml_files << file_name;
 
         const auto target_path = path + '/' + FOLDER + file_name;
-        QFile component_out(target_path);
-        if(QFile::exists(target_path)) {
+        const auto written = manifest.write(target_path, component_src);
+        VERIFO((written != OutputManifest::Write::Error), "Cannot write component " + file_name + " " + manifest.errorString());
+        if(written == OutputManifest::Write::Changed)
             qDebug() << "File replaced" << target_path;
-            QFile::remove(target_path);
-        }
-        VERIFO(component_out.open(QFile::WriteOnly), "Cannot write component " + file_name);
-
-        component_out.write(component_src);
-        component_out.close();
     }
     return std::make_tuple(qml_files, save_image_filter);
 }
@@ -240,6 +229,7 @@ std::optional<std::tuple<QStringList, QStringList, QStringList>> ExecuteUtils::w
         VERIFO(QDir(path).removeRecursively(), "Cannot clean folder");
     }
 
+    OutputManifest manifest; // written during this export only, as the folder is cleaned above
     const auto abs_path = QFileInfo(path).absolutePath();
     VERIFO(QDir().mkpath(path + '/' + FOLDER + QML_PREFIX), "Cannot create folder " + abs_path + FOLDER + QML_PREFIX)
 
@@ -258,7 +248,7 @@ std::optional<std::tuple<QStringList, QStringList, QStringList>> ExecuteUtils::w
     //qml_files.append(file_name);
     qml_view_names.append(file_name);
 
-    const auto mwo = ExecuteUtils::writeElement(path, file_name, figmaQml, {figmaQml.currentCanvas(), figmaQml.currentElement()});
+    const auto mwo = ExecuteUtils::writeElement(path, file_name, figmaQml, {figmaQml.currentCanvas(), figmaQml.currentElement()}, manifest);
     if(!mwo)
         return std::nullopt; // it already tells what went wrong
     const auto& [mcomponents, mfilter] = mwo.value();
@@ -272,7 +262,7 @@ std::optional<std::tuple<QStringList, QStringList, QStringList>> ExecuteUtils::w
         const auto canvas_index = map["canvas"].toInt();
         const auto element_index = map["element"].toInt();
         const auto file_name =  QML_PREFIX + FigmaQml::validFileName(element_name) + QML_EXT;
-        const auto wo = ExecuteUtils::writeElement(path, file_name, figmaQml, {canvas_index, element_index});
+        const auto wo = ExecuteUtils::writeElement(path, file_name, figmaQml, {canvas_index, element_index}, manifest);
         if(!wo)
             return std::nullopt; // it already tells what went wrong
         const auto& [components, filter] = wo.value();
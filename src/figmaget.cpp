@@ -69,9 +69,6 @@ FigmaGet::FigmaGet(QObject *parent) : FigmaProvider(parent),
      QObject::connect(this, &FigmaGet::error, [this](const QString&) {
          cancel();
          m_connectionState = State::Error;
-         m_images->clean(false);
-         m_renderings->clean(false);
-         m_nodes->clean(false);
      });
 
      //cancel -> downloads cancel -> error -> cancel loop
@@ -130,7 +127,7 @@ void FigmaGet::onRetrievedNode(const QString& nodeId) {
 
 bool FigmaGet::isReady() {
 
-    return m_callQueue.isEmpty() && m_timeout->pending() == 0;
+    return m_callQueue.isEmpty() && m_timeout->pending() == 0 && m_resizing == 0;
 }
 
 void FigmaGet::doFinished(QNetworkReply* rep)
@@ -261,8 +258,18 @@ bool FigmaGet::read(QDataStream& stream) {
     return stream.status() == QDataStream::Ok;
 }
 
+// images under resize are not stored
+void FigmaGet::cancelResizes() {
+    for(auto& resize : m_resizes)
+        resize.cancel();
+    m_resizes.clear();
+    m_resizing = 0;
+    ++m_resizeEpoch;
+}
+
 void FigmaGet::reset() {
     m_timeout->reset();
+    cancelResizes();
     m_callTimer.stop();
     m_downloads->reset();
     m_images->clear();
@@ -283,7 +290,15 @@ void FigmaGet::cancel() {
         r->close();
     }
     m_downloads->cancel();
+    m_callTimer.stop();
     m_callQueue.clear();
+    m_rendringQueue.clear();
+    m_timeout->reset();
+    cancelResizes();
+    // not fetched data is requested again
+    m_images->clean(false);
+    m_renderings->clean(false);
+    m_nodes->clean(false);
 }
 
 void FigmaGet::doCall() {
@@ -435,39 +450,40 @@ QNetworkReply* FigmaGet::doRetrieveImage(const Id& id, FigmaData *target, const
             return;
         }
 
-            if(maxSize.width() < std::numeric_limits<int>::max() || maxSize.height() < std::numeric_limits<int>::max()) {
+        const auto store = [this, target, id, format](const QByteArray& data) {
+            if(target->isEmpty(id.id) && m_connectionState == State::Loading) {  //there CAN be multiple requests within multithreaded, but we use only first
+                Q_ASSERT(format == "png" || format == "jpeg");
+                target->setBytes(id.id, data, format == "png" ? PNG : JPEG);
+            }
+            Q_ASSERT(FetchFailedDebug.find(id.id) == FetchFailedDebug.end());
+            emit imageRetrieved(id.id);
+        };
+
+        if(maxSize.width() < std::numeric_limits<int>::max() || maxSize.height() < std::numeric_limits<int>::max()) {
 #ifdef DUMP_IMAGE
 #pragma message("DUMP_IMAGE is defined, Do dump for every rendering...")
             const auto dumpImage = imageReader.read();
             dumpImage.save("figma_+ " + id + "." + imageReader.format());
 #endif
+            // only the header is read here, decoding and resizing is done in the thread pool
             if(imageReader.size().width() > maxSize.width() || imageReader.size().height() > maxSize.height()) {
-
-                const auto image = imageReader.read();
-                const auto scaled = image.scaled(maxSize, Qt::KeepAspectRatio);
-                bytes->clear();
-
-                QBuffer buffer(bytes.get(), this);
-                if(scaled.isNull() || !buffer.open(QIODevice::WriteOnly)) {
-                    setError(id, "%1 %2" + QString(" cannot be resized to %2x%3").arg(maxSize.width(), maxSize.height()));
-                    return;
-                }
-
-                QImageWriter writer(&buffer, format);
-                if(!writer.write(scaled)) {
-                    setError(id, "%1 %2" + QString(" cannot be resized %2")
-                                   .arg(writer.errorString()));
-                    return;
-                }
-                buffer.close();
+                ++m_resizing;
+                m_resizes.removeIf([](const auto& resize) {return resize.isFinished();});
+                m_resizes.append(ImageResize::run(*bytes, format, maxSize));
+                m_resizes.last().then(this, [this, id, store, epoch = m_resizeEpoch](const ImageResize::Result& result) {
+                    if(epoch != m_resizeEpoch)
+                        return; // cancelled
+                    --m_resizing;
+                    if(!result.error.isEmpty()) {
+                        setError(id, "%1 %2 " + result.error);
+                        return;
+                    }
+                    store(result.bytes);
+                });
+                return;
             }
         }
-        if(target->isEmpty(id.id) && m_connectionState == State::Loading) {  //there CAN be multiple requests within multithreaded, but we use only first
-            Q_ASSERT(format == "png" || format == "jpeg");
-            target->setBytes(id.id, *bytes, format == "png" ? PNG : JPEG);
-        }
-        Q_ASSERT(FetchFailedDebug.find(id.id) == FetchFailedDebug.end());
-        emit imageRetrieved(id.id);
+        store(*bytes); // not resized, used as is
     };
 
     setTimeout(reply, id);
@@ -814,25 +830,16 @@ Downloads* FigmaGet::downloadProgress() {
 
 
 std::optional<std::tuple<QByteArray, int>> FigmaGet::cachedImage(const QString& imageRef) {
-    if(!m_images->contains(imageRef) ||
-            m_images->isEmpty(imageRef) ||
-            m_images->isPending(imageRef))
-        return std::nullopt;
-    return std::make_optional(std::make_tuple(m_images->data(imageRef), m_images->format(imageRef)));
+    return m_images->tryData(imageRef);
 }
 
 std::optional<std::tuple<QByteArray, int>> FigmaGet::cachedRendering(const QString& figmaId) {
-    if(!m_renderings->contains(figmaId) ||
-            m_renderings->isEmpty(figmaId) ||
-            m_renderings->isPending(figmaId))
-        return std::nullopt;
-    return std::make_optional(std::make_tuple(m_renderings->data(figmaId), m_renderings->format(figmaId)));
+    return m_renderings->tryData(figmaId);
 }
 
 std::optional<QByteArray> FigmaGet::cachedNode(const QString& figmaId) {
-    if(!m_nodes->contains(figmaId) ||
-            m_nodes->isEmpty(figmaId) ||
-            m_nodes->isPending(figmaId))
+    const auto node = m_nodes->tryData(figmaId);
+    if(!node)
         return std::nullopt;
-    return std::make_optional(m_nodes->data(figmaId));
+    return std::get<QByteArray>(*node);
 }
@@ -138,11 +138,17 @@ std::optional<FigmaParser::ItemType> FigmaParser::type(const QJsonObject& obj) {
 }
 
 
-std::optional<FigmaParser::Components> FigmaParser::components(const QJsonObject& project, FigmaParserData& data) {
+// if roots are given, only components they depend on (transitively) are resolved, thus fetched and generated
+std::optional<FigmaParser::Components> FigmaParser::components(const QJsonObject& project, FigmaParserData& data, const QSet<QString>* roots) {
         Components map; 
         auto componentObjects = getObjectsByType(project["document"].toObject(), "COMPONENT");
         const auto components = project["components"].toObject();
-        for (const auto& key : components.keys()) {
+        auto keys = roots ? QStringList(roots->begin(), roots->end()) : components.keys();
+        QSet<QString> visited(keys.begin(), keys.end());
+        while(!keys.isEmpty()) {
+            const auto key = keys.takeFirst();
+            if(!components.contains(key))
+                continue;
             if(!componentObjects.contains(key)) {
                 const auto response = data.nodeData(key);
                 if(response.isEmpty()) {
@@ -163,19 +169,18 @@ std::optional<FigmaParser::Components> FigmaParser::components(const QJsonObject
                     ERR(toStr("Invalid component", key));
                 }
             }
+            if(roots) {
+                const auto dependencies = componentDependencies(componentObjects[key]);
+                for(const auto& d : dependencies) {
+                    if(!visited.contains(d)) {
+                        visited.insert(d);
+                        keys.append(d);
+                    }
+                }
+            }
             const auto c = components[key].toObject();
             const auto componentName = c["name"].toString();
-            auto uniqueComponentName = validFileName(componentName, false); //names are expected to be unique, so we ensure so
-            /*
-            int count = 1;
-            while(std::find_if(map.begin(), map.end(), [&uniqueComponentName](const auto& c) {
-                return c->name() == uniqueComponentName;
-            }) != map.end()) {
-                uniqueComponentName = validFileName(QString("%1_%2").arg(componentName, count), false);
-                ++count;
-            }
-
-            qDebug() << "uniqueComponentName" << uniqueComponentName << " " << foo;*/
+            const auto uniqueComponentName = data.uniqueName(key, componentName); //names are expected to be unique, so we ensure so
 
 
             map.insert(key, std::shared_ptr<Component>(new Component(
@@ -189,6 +194,19 @@ std::optional<FigmaParser::Components> FigmaParser::components(const QJsonObject
         return map;
     }
 
+    QSet<QString> FigmaParser::componentDependencies(const QJsonObject& obj) {
+        QSet<QString> ids;
+        const auto type = obj["type"].toString();
+        if(type == "INSTANCE")
+            ids.insert(obj["componentId"].toString());
+        else if(type == "COMPONENT")
+            ids.insert(obj["id"].toString());
+        const auto children = obj["children"].toArray();
+        for(const auto& child : children)
+            ids.unite(componentDependencies(child.toObject()));
+        return ids;
+    }
+
     std::optional<FigmaParser::Canvases> FigmaParser::canvases(const QJsonObject& project) {
         Canvases array;
 
@@ -223,30 +241,8 @@ std::optional<FigmaParser::Components> FigmaParser::components(const QJsonObject
          return project["name"].toString();
     }
 
-    QString FigmaParser::validFileName(const QString& itemName, bool inited) {
-        if(itemName.isEmpty())
-            return QString();
-
-        Q_ASSERT(inited == itemName.endsWith(FIGMA_SUFFIX));
-        auto name = itemName;
-
-        // TODO this makes store-restore not to work as shall be cleaned inbetween access
-        // static is a bit cheap solution to ensure unique names, but proper fix (be a class member) requires some refactoring
-        // TODO a 'elegant' fix.
-        static QMap<QString, int> unique_names;
-
-        if(!inited) {
-            auto it = unique_names.find(name);
-            if(it == unique_names.end()) {
-                unique_names.insert(name, 0);
-            } else {
-                *it += 1; // if there add a name - note that this can be non-unique as well... :-/ ooof but let's go with this until
-                name += QString::number(*it);    // properly done....(if ever)
-            }
-            name += FIGMA_SUFFIX;
-           }
-
-        return makeFileName(name);
+    QByteArray FigmaParser::makeClipRect(const QRect& rect) {
+        return QString("sourceClipRect: Qt.rect(%1, %2, %3, %4)").arg(rect.x()).arg(rect.y()).arg(rect.width()).arg(rect.height()).toLatin1();
     }
 
     QString FigmaParser::makeFileName(const QString& fileName) {
@@ -262,12 +258,9 @@ std::optional<FigmaParser::Components> FigmaParser::components(const QJsonObject
         return name;
     }
 
-    FigmaParser::FigmaParser(unsigned flags, FigmaParserData& data, const Components* components) : m_flags(flags), m_data(data), m_components(components), m_parent{nullptr, nullptr, {}} {}
+    FigmaParser::FigmaParser(unsigned flags, FigmaParserData& data, const Components* components) : m_flags(flags), m_data(data), m_components(components) {}
 
-    FigmaParser::~FigmaParser() {
-        while(m_parent.parent)      // this is NOT very rigid, but at least not leak :-/ (better would be assert here that all memory has freed (what push, its pop))
-            m_parent.pop();
-    }
+    FigmaParser::~FigmaParser() {}
 
     QHash<QString, QJsonObject> FigmaParser::getObjectsByType(const QJsonObject& obj, const QString& type) {
         QHash<QString, QJsonObject>objects;
@@ -356,7 +349,7 @@ std::optional<FigmaParser::Components> FigmaParser::components(const QJsonObject
             aliases.append(alias.id);
 
         return Element{
-                validFileName(obj["name"].toString(), false),
+                m_data.uniqueName(obj["id"].toString(), obj["name"].toString()),
                 obj["id"].toString(),
                 obj["type"].toString(),
                 std::move(bytes.value()),
@@ -421,17 +414,30 @@ std::optional<FigmaParser::Components> FigmaParser::components(const QJsonObject
     }
 
      QByteArray FigmaParser::makeId(const QJsonObject& obj)  {
-        QString cid = obj["id"].toString();
-        static const QRegularExpression re(R"([^a-zA-Z0-9])");
-        const auto qml_id = ID_PREFIX + cid.replace(re, "_").toLower().toLatin1();
-        //if(qml_id == "figma_711_1213") {
-        //    qDebug() << "what is here?";
-        //}
-        /*
-        TODO: Really not working - why there are unable to find_id errors
-        if(m_parent.parent->parent)  // presumably this prevents toplevel alias?*/
-            m_parent.ids.insert(QString(qml_id));
-        return qml_id;
+        return qmlId(obj);
+    }
+
+    // ids are generated once per node, non alphanumerics are replaced with '_'
+    const QByteArray& FigmaParser::qmlId(const QJsonObject& obj) {
+        const auto cid = obj["id"].toString();
+        auto it = m_qmlIds.find(cid);
+        if(it == m_qmlIds.end()) {
+            QByteArray qml_id(ID_PREFIX);
+            qml_id.reserve(qml_id.size() + cid.size());
+            for(const auto& c : cid) {
+                if(c.isLowSurrogate())
+                    continue; // a surrogate pair is a single character
+                const auto ch = c.unicode();
+                if((ch >= 'a' && ch <= 'z') || (ch >= '0' && ch <= '9'))
+                    qml_id += static_cast<char>(ch);
+                else if(ch >= 'A' && ch <= 'Z')
+                    qml_id += static_cast<char>(ch - 'A' + 'a');
+                else
+                    qml_id += '_';
+            }
+            it = m_qmlIds.insert(cid, qml_id);
+        }
+        return *it;
     }
 
      /*
@@ -511,11 +517,7 @@ std::optional<FigmaParser::Components> FigmaParser::components(const QJsonObject
 
 
     QByteArray FigmaParser::makeId(const QString& prefix, const QJsonObject& obj)  {
-        QString cid = obj["id"].toString();
-        static const QRegularExpression re(R"([^a-zA-Z0-9])");
-        const auto qml_id = prefix.toLatin1() + ID_PREFIX + cid.replace(re, "_").toLower().toLatin1();
-        m_parent.ids.insert(QString(qml_id));
-        return qml_id;
+        return prefix.toLatin1() + qmlId(obj);
     }
 
      EByteArray FigmaParser::makeComponentInstance(const QString& type, const QJsonObject& obj, int indents, const QByteArray& change_receiver) {
@@ -612,8 +614,8 @@ std::optional<FigmaParser::Components> FigmaParser::components(const QJsonObject
         }
         if(obj.contains("relativeTransform")) { //even figma may contain always this, the deltainstance may not
             const auto p = position(obj);
-            Q_ASSERT(m_parent.parent);
-            const bool top_level = m_parent.parent->parent == nullptr;
+            Q_ASSERT(!m_parent.isEmpty());
+            const bool top_level = m_parent.isTopLevel();
             const auto tx = static_cast<int>(!top_level ? p.x() + extents.x() : extents.x());
             const auto ty = static_cast<int>(!top_level ? p.y() + extents.y() : extents.y());
 
@@ -787,10 +789,12 @@ std::optional<FigmaParser::Components> FigmaParser::components(const QJsonObject
         QByteArray out;
         m_imageContext.insert(image);
         auto imageData = m_data.imageData(image, isRendering);
+        auto source = image;
         if(imageData.isEmpty()) {
             if(placeHolder.isEmpty()) {
                 ERR("Cannot read imageRef", image)
             } else {
+                source = placeHolder;
                 imageData = m_data.imageData(placeHolder, isRendering);
                  if(imageData.isEmpty()) {
                      ERR("Cannot load placeholder");
@@ -805,6 +809,9 @@ std::optional<FigmaParser::Components> FigmaParser::components(const QJsonObject
         }
 
         out += tabs(indents) + "source: \"" + imageData + "\"\n";
+        const auto clip = m_data.imageClip(source);
+        if(clip) // image is in an atlas
+            out += tabs(indents) + makeClipRect(*clip) + "\n";
         return out;
     }
 
@@ -1058,6 +1065,8 @@ std::optional<FigmaParser::Components> FigmaParser::components(const QJsonObject
     }
 
     EByteArray FigmaParser::parse(const QJsonObject& obj, int indents) {
+        if(m_data.isCancelled())
+            ERR("Cancelled");
         const auto type = obj["type"].toString();
         const QHash<QString, std::function<EByteArray (const QJsonObject&, int)> > parsers {
             {"RECTANGLE", std::bind(&FigmaParser::parseVector, this, std::placeholders::_1, std::placeholders::_2)},
@@ -2429,7 +2438,7 @@ std::optional<FigmaParser::Components> FigmaParser::components(const QJsonObject
 
           // add alias set signal
 
-          if(!m_parent.parent->parent && generateAccess()) {
+          if(m_parent.isTopLevel() && generateAccess()) {
             out += makePropertyChangeHandler(indents);
             }
           return out;
@@ -2470,6 +2479,7 @@ std::optional<FigmaParser::Components> FigmaParser::components(const QJsonObject
     std::optional<OrderedMap<QString, QByteArray>> FigmaParser::parseChildrenItems(const QJsonObject& obj, int indents) {
         OrderedMap<QString, QByteArray> childrenItems;
         m_parent.push(&obj);
+        RAII_ raii {[this](){m_parent.pop();}};
         if(obj.contains("children")) {
             bool hasMask = false;
             QByteArray out;
@@ -2498,7 +2508,6 @@ std::optional<FigmaParser::Components> FigmaParser::components(const QJsonObject
             }
         }
         //m_parent = parent;
-        m_parent.pop();
         return childrenItems;
     }
 
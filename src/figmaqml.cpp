@@ -2,19 +2,39 @@
 #include "figmaparser.h"
 #include "figmaqml.h"
 #include "fontcache.h"
+#include "nodecache.h"
+#include "nameregistry.h"
+#include "outputmanifest.h"
+#include "outputwriter.h"
+#include "qmlstore.h"
+#include "figmaimageprovider.h"
+#include "imageatlas.h"
+#include "fontindex.h"
+#include "fontfolder.h"
+#ifdef ZIP_EXPORT
+#include "zipwriter.h"
+#include <QSaveFile>
+#endif
+#include <QBuffer>
+#include <QImageReader>
 #include "fontinfo.h"
 #include "utils.h"
 #include "appwrite.h"
 #include <QVersionNumber>
 #include <QTimer>
-#include <QSaveFile>
 #include <QSize>
 #include <QQmlEngine>
 #include <QDir>
+#include <QDateTime>
 #include <QFontDatabase>
 #include <QFontInfo>
+#include <QMutex>
 #include <QStandardPaths>
 #include <QFileInfo>
+#include <QCryptographicHash>
+#include <QEventLoop>
+#include <QCoreApplication>
+#include <QGuiApplication>
 #ifdef USE_NATIVE_FONT_DIALOG
 #include <QFontDialog>
 #include <QApplication>
@@ -35,29 +55,27 @@ const QLatin1String qmlViewPath("/qml/");
 //why there were two folders? onst QLatin1String sourceViewPath("/sources/");
 const QLatin1String Images("/images/");
 const QLatin1String FileHeader("//Generated by FigmaQML %1\n\n");
+const QLatin1String NodeCachePath("/nodes");
+const QLatin1String FontCachePath("/fonts/");
+constexpr int FontCacheFiles = 16; // font sets that are kept
+const QLatin1String FontFolderCachePath("/fontfolder");
+// flags that has no effect on the generated code, or are handled elsewhere
+constexpr unsigned NonCodeFlags = FigmaQml::EmbedImages | FigmaQml::Timed | FigmaQml::AltFontMatch | FigmaQml::KeepFigmaFontName | FigmaQml::QulPreconvertImages;
 
-static int levenshteinDistance(const QString& s1, const QString& s2) {
-    const auto l1 = s1.length();
-    const auto l2 = s2.length();
-
-    auto dist = std::vector<std::vector<int>>(l2 + 1, std::vector<int>(l1 + 1));
-
+// font folder families are alternatives too, they are added to the font database when used
+static QMutex FontIndexMutex;
+static QStringList FolderFamilies;
+static unsigned FontGeneration = 0; // bumped when the available families change
 
-    for(auto i = 0; i <= l1 ; i++) {
-       dist[0][i] = i;
-    }
+static void fontsChanged() {
+    QMutexLocker lock(&FontIndexMutex);
+    ++FontGeneration;
+}
 
-    for(auto j = 0; j <= l2; j++) {
-       dist[j][0] = j;
-    }
-    for (auto j = 1; j <= l1; j++) {
-       for(auto i = 1; i <= l2 ;i++) {
-          const auto track = (s2[i-1] == s1[j-1]) ? 0 : 1;
-          const auto t = std::min((dist[i - 1][j] + 1), (dist[i][j - 1] + 1));
-          dist[i][j] = std::min(t, (dist[i - 1][j - 1] + track));
-       }
-    }
-    return dist[l2][l1];
+static void setFolderFamilies(const QStringList& families) {
+    QMutexLocker lock(&FontIndexMutex);
+    FolderFamilies = families;
+    ++FontGeneration;
 }
 
 enum Format {
@@ -105,12 +123,15 @@ QString FigmaQml::documentsLocation() const {
 }
 
 const auto FrameDelay = 500ms;
+const auto SourceTimeout = 60s; // max wait for the data of an element without receiving anything
+const auto CancelLatency = 50ms; // time slice of an interactive generation
 
 bool FigmaQml::setCurrentElement(int current) {
     if(current < 0 || current >= elementCount())
         return false;
     if(current != currentElement()) {
         m_uiDoc->getCurrent()->setCurrent(current);
+        generateCurrent();
         emit elementNameChanged();
         QTimer::singleShot(FrameDelay, this, [this](){emit currentElementChanged();}); //delayed
     }
@@ -125,6 +146,7 @@ bool FigmaQml::setCurrentCanvas(int current) {
         if(m_uiDoc->currentIndex() >= m_uiDoc->current().size()) {
             m_uiDoc->getCurrent()->setCurrent(m_uiDoc->current().size() - 1);
         }
+        generateCurrent();
         emit currentCanvasChanged();
         emit elementNameChanged();
         emit elementCountChanged();
@@ -139,73 +161,174 @@ QString FigmaQml::validFileName(const QString& name) {
    return FigmaParser::makeFileName(name);
 }
 
-bool FigmaQml::saveAllQML(const QString& folderName) {
-#ifdef Q_OS_WINDOWS
-    QDir d(folderName.startsWith('/') ? folderName.mid(1) : folderName);
-#else
-    QDir d(folderName);
-#endif
-    if(!ensureDirExists(d.absolutePath())) {
-        return false;
-    }
+// writes generated elements and components, returns the number of files
+std::optional<int> FigmaQml::writeSources(const std::function<bool (const QString& fileName, const QByteArray& data)>& write) {
+    if(m_yielding)
+        return std::nullopt;
+    m_doCancel = false;
+    if(!m_streaming && !generateAll())
+        return std::nullopt;
     QSet<QString> componentNames;
+    int elementCount = 0;
+    int canvasIndex = 0;
     for(const auto& c : *m_sourceDoc) {
+        ++canvasIndex;
+        int elementIndex = 0;
         for(const auto& e : *c) {
-            const auto sourceName = FigmaParser::makeFileName(c->name());
-            const auto name = QString("%1/%2_%3.qml").arg(d.absolutePath(), sourceName, e->name());
-            const auto fullname = uniqueFilename(name, e->data());
-            if(!fullname) // that is already there
+            ++elementIndex;
+            if(isFiltered(canvasIndex, elementIndex))
                 continue;
-            QSaveFile file(*fullname);
-            if(!file.open(QIODevice::WriteOnly)) {
-                emit error(QString("Failed to write %1 %2 %3 %4").arg(file.errorString(), *fullname, d.absolutePath(), e->name()));
-                return false;
-            }
-            if(e->data().length() == 0 || file.write(e->data()) < 0) {
-                emit error(QString("Failed to write %1 %2 %3 %4").arg(file.errorString(), *fullname, d.absolutePath(), e->name()));
-                return false;
+            if(m_doCancel)
+                return std::nullopt;
+            const auto elementId = m_streaming && m_lazySource ? m_lazySource->pending.value({canvasIndex - 1, elementIndex - 1})["id"].toString() : QString();
+            if(m_streaming && !generateSource(canvasIndex - 1, elementIndex - 1))
+                return std::nullopt;
+            RAII(([&]() {
+                if(m_streaming) { // written, not needed anymore
+                    c->release(elementIndex - 1);
+                    m_nodeCache->releaseElement(elementId);
+                }
+            }));
+            ++elementCount;
+            const auto sourceName = FigmaParser::makeFileName(c->name());
+            const auto name = QString("%1_%2.qml").arg(sourceName, e->name());
+            if(e->data().length() == 0) {
+                emit error(QString("Failed to write %1, no data").arg(name));
+                return std::nullopt;
             }
+            if(!write(name, e->data()))
+                return std::nullopt;
             const auto elementComponents = m_sourceDoc->components(e->name());
             componentNames.unite(QSet(elementComponents.begin(), elementComponents.end()));
-            file.commit();
         }
     }
 
-    for(const auto& componentName : componentNames) {
+    for(const auto& componentName : m_sourceDoc->componentOrder()) {
+        if(!componentNames.contains(componentName))
+            continue;
         Q_ASSERT(componentName.endsWith(FIGMA_SUFFIX));
-        const auto name = QString("%1/%2.qml").arg(d.absolutePath(), componentName);
+        if(!m_sourceDoc->containsComponent(componentName)) {
+            emit error(QString("Failed to find \"%1\" on write").arg(componentName));
+            return std::nullopt;
+        }
         const auto cd = m_sourceDoc->component(componentName);
-        const auto fullname = uniqueFilename(name, cd);
-        if(!fullname)
-            continue;
-        QSaveFile file(*fullname);
-        if(!file.open(QIODevice::WriteOnly)) {
-            emit error(QString("Failed to write \"%1\" \"%2\" \"%3\" \"%4\"").arg(file.errorString(), *fullname, d.absolutePath(), componentName));
+        if(cd.length() == 0) {
+            emit error(QString("Failed to write \"%1\", no data").arg(componentName));
+            return std::nullopt;
+        }
+        if(!write(componentName + ".qml", cd))
+            return std::nullopt;
+    }
+    return elementCount + componentNames.count();
+}
+
+bool FigmaQml::saveAllQML(const QString& folderName) {
+#ifdef Q_OS_WINDOWS
+    QDir d(folderName.startsWith('/') ? folderName.mid(1) : folderName);
+#else
+    QDir d(folderName);
+#endif
+    if(!ensureDirExists(d.absolutePath())) {
+        return false;
+    }
+    OutputManifest manifest(d.absolutePath());
+    const auto count = writeSources([&](const QString& fileName, const QByteArray& data) {
+        const auto fullname = uniqueFilename(d.absolutePath() + '/' + fileName, data);
+        if(!fullname) // that is already there
+            return true;
+        if(manifest.write(*fullname, data, m_writer.get()) == OutputManifest::Write::Error) {
+            emit error(QString("Failed to write \"%1\" \"%2\" \"%3\"").arg(manifest.errorString(), *fullname, d.absolutePath()));
             return false;
         }
+        return true;
+    });
 
-        if(!m_sourceDoc->containsComponent(componentName)) {
-            emit error(QString("Failed to find \"%1\" on write").arg(componentName));
+    if(!flushOutput() || !count)
+        return false;
+
+    if(!manifest.save())
+        emit warning(QString("Cannot save manifest into %1").arg(d.absolutePath()));
+
+    if(!saveImages(d.absolutePath() + Images))
+        return false;
+    emit info(QString("%1 files written into %2").arg(QSet<QString>(m_imageNames.cbegin(), m_imageNames.cend()).size() + *count)
+              .arg(d.absolutePath()));
+    reportImageStats();
+    return true;
+}
+
+#ifdef ZIP_EXPORT
+bool FigmaQml::saveAllQMLToZip(const QString& zipName) {
+    QSaveFile archive(zipName);
+    QFile standardOutput;
+    QIODevice* device = &archive;
+    if(zipName == "-") {
+        if(!standardOutput.open(stdout, QIODevice::WriteOnly)) {
+            emit error(QString("Cannot write to stdout %1").arg(standardOutput.errorString()));
             return false;
         }
+        device = &standardOutput;
+    } else if(!archive.open(QIODevice::WriteOnly)) {
+        emit error(QString("Cannot write %1 %2").arg(zipName, archive.errorString()));
+        return false;
+    }
 
-        if(cd.length() == 0 || file.write(cd) < 0) {
-            emit error(QString("Failed to write \"%1\" \"%2\" \"%3\" \"%4\"").arg(file.errorString(), *fullname, d.absolutePath(), componentName));
+    ZipWriter zip(device);
+    if(!zip.isOpen()) {
+        emit error(QString("Cannot create zip %1 (%2)").arg(zipName).arg(zip.error()));
+        return false;
+    }
+
+    QSet<QString> written;
+    const auto count = writeSources([&](const QString& fileName, const QByteArray& data) {
+        if(written.contains(fileName))
+            return true;
+        written.insert(fileName);
+        if(!zip.add(fileName, data, ZipWriter::Method::Compress)) {
+            emit error(QString("Failed to write \"%1\" into \"%2\" (%3)").arg(fileName, zipName).arg(zip.error()));
+            return false;
+        }
+        return true;
+    });
+    writeAtlas();
+    if(!count || !flushOutput())
+        return false;
+
+    for(const auto& [k, i] : m_imageFiles.asKeyValueRange()) {
+        if(written.contains(Images.mid(1) + i.second))
+            continue; // duplicate image
+        written.insert(Images.mid(1) + i.second);
+        const auto bytes = m_imageData.value(i.second);
+        // images are compressed already
+        if(bytes.isEmpty() || !zip.add(Images.mid(1) + i.second, bytes, ZipWriter::Method::Store)) {
+            emit error(QString("Failed to write \"%1\" into \"%2\" (%3)").arg(i.second, zipName).arg(zip.error()));
             return false;
         }
-        file.commit();
     }
 
-    if(!saveImages(d.absolutePath() + Images))
+    if(!zip.close() || (device == &archive && !archive.commit())) {
+        emit error(QString("Failed to write %1 (%2)").arg(zipName).arg(zip.error()));
         return false;
-    emit info(QString("%1 files written into %2").arg(m_imageFiles.size() + componentNames.count()
-                                                      + std::accumulate(m_sourceDoc->begin(), m_sourceDoc->end(), 0, [](const auto &a, const auto& c){return a + c->size();}))
-              .arg(d.absolutePath()));
+    }
+    emit info(QString("%1 files written into %2").arg(written.size()).arg(zipName));
+    reportImageStats();
     return true;
 }
+#endif
 
 QUrl FigmaQml::element() const {
-    return (m_uiDoc && !m_uiDoc->empty()) ?  QUrl::fromLocalFile(QString(m_uiDoc->current().data())) : QUrl();
+    if(!m_uiDoc || m_uiDoc->empty())
+        return QUrl();
+    const auto fileName = QString(m_uiDoc->current().data());
+    return m_qmlStore ? QmlStore::url(QFileInfo(fileName).fileName()) : QUrl::fromLocalFile(fileName);
+}
+
+void FigmaQml::setQmlStore(const std::shared_ptr<QmlStore>& store) {
+    m_qmlStore = store;
+}
+
+void FigmaQml::setImageProvider(bool hasProvider) {
+    m_hasImageProvider = hasProvider;
 }
 
 QByteArray FigmaQml::sourceCode() const {
@@ -213,9 +336,14 @@ QByteArray FigmaQml::sourceCode() const {
 }
 
 FigmaQml::FigmaQml(const QString& qmlDir, const QString& fontFolder, FigmaProvider& provider, QObject *parent) : QObject(parent),
-    m_qmlDir(qmlDir), mProvider(provider), m_imports(defaultImports()), m_fontCache(std::make_unique<FontCache>()), m_fontFolder(fontFolder),
+    m_qmlDir(qmlDir), mProvider(provider), m_writer(std::make_unique<OutputWriter>()), m_imports(defaultImports()), m_fontCache(std::make_unique<FontCache>()), m_nodeCache(std::make_unique<NodeCache>()), m_names(std::make_unique<NameRegistry>()), m_fontFolder(fontFolder),
     m_fontInfo{ new FontInfo{this} } {
     qmlRegisterUncreatableType<FigmaQml>("FigmaQml", 1, 0, "FigmaQml", "");
+    m_nodeCache->setDirectory(QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + NodeCachePath);
+    m_nodeCache->setFontResolver([this](const QString& requestedFont) {return resolveFont(requestedFont);});
+    QObject::connect(this, &FigmaQml::cancelled, this, &FigmaQml::doCancel);
+    if(const auto app = qobject_cast<QGuiApplication*>(QCoreApplication::instance()))
+        QObject::connect(app, &QGuiApplication::fontDatabaseChanged, this, &fontsChanged);
     QObject::connect(this, &FigmaQml::currentElementChanged, this, [this]() {
         if(!m_uiDoc) {
             emit error("Invalid element!");
@@ -242,26 +370,43 @@ FigmaQml::FigmaQml(const QString& qmlDir, const QString& fontFolder, FigmaProvid
 
 #ifdef Q_OS_LINUX
     QObject::connect(m_fontInfo, &FontInfo::fontPath, this, &FigmaQml::fontPathFound);
+    QObject::connect(m_fontInfo, &FontInfo::fontPaths, this, &FigmaQml::fontPathsFound);
     QObject::connect(m_fontInfo, &FontInfo::pathError, this, &FigmaQml::fontPathError);
 #endif
+    // the font files are only scanned here, they are added to the font database when used
     const auto fontFolderChanged = [this]() {
+        const auto scan = ++m_fontScans;
+        m_folderFonts.clear();
+        setFolderFamilies({});
+        if(m_fontFolder.isEmpty())
+            return;
         const QDir fontFolder(m_fontFolder);
-        if(!fontFolder.exists())
+        if(!fontFolder.exists()) {
             emit warning(QString("Folder \"%1\", not found").arg(m_fontFolder));
-        for(const auto& entry : fontFolder.entryInfoList()) {
-            int id = -1;
-            if(!entry.isDir() && !entry.fileName().endsWith(".txt") &&  (id = QFontDatabase::addApplicationFont(entry.absoluteFilePath())) < 0)
-                emit warning(QString("Font \"%1\", cannot be loaded").arg(entry.absoluteFilePath()));
-            else {
-                const auto families = QFontDatabase::applicationFontFamilies(id);
-                if(!families.isEmpty()) {
-                    QFont font(families);
-                    emit info("font \"" + entry.fileName() + "\" loaded");
-                    qDebug() << "Font" << entry.absoluteFilePath() << "loaded "<< font;
-                    emit fontLoaded(font);
-                }
-             }
+            return;
         }
+        m_fontScan = FontFolder::run(fontFolder.absolutePath(), QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + FontFolderCachePath)
+                .then(this, [this, scan](const FontFolder::Families& fonts) {
+            if(scan != m_fontScans) // folder changed meanwhile
+                return;
+            QStringList folderFamilies;
+            for(auto it = fonts.constBegin(); it != fonts.constEnd(); ++it) {
+                const auto& face = it.value();
+                if(face.families.isEmpty()) {
+                    emit warning(QString("Font \"%1\", cannot be loaded").arg(it.key()));
+                    continue;
+                }
+                m_fontInfo->addFontFile(it.key(), face.families, face.weight, face.italic);
+                for(const auto& family : face.families) {
+                    m_folderFonts.insert(family.toLower(), it.key());
+                    if(FontIndex::normalized(family) != family.toLower())
+                        m_folderFonts.insert(FontIndex::normalized(family), it.key());
+                    if(!folderFamilies.contains(family))
+                        folderFamilies.append(family);
+                }
+            }
+            setFolderFamilies(folderFamilies);
+        });
     };
 
     QObject::connect(this, QOverload<FigmaFileDocument*>::of(&FigmaQml::figmaDocumentCreated), this, [this](FigmaFileDocument* doc) {
@@ -281,6 +426,7 @@ FigmaQml::FigmaQml(const QString& qmlDir, const QString& fontFolder, FigmaProvid
         if(mRestore)
             mRestore(doc);
         mRestore = nullptr;
+        generateCurrent();
     });
 
     QObject::connect(this, &FigmaQml::error, this, [this](const QString&) {
@@ -296,6 +442,7 @@ FigmaQml::FigmaQml(const QString& qmlDir, const QString& fontFolder, FigmaProvid
             m_sourceDoc.reset(doc);
             emit sourceCodeChanged();
             emit documentCreated();
+            generateCurrent();
         } else {
             emit error("Invalid document");
         }
@@ -318,15 +465,19 @@ FigmaQml::FigmaQml(const QString& qmlDir, const QString& fontFolder, FigmaProvid
 }
 
 void FigmaQml::applyExternalLoaders() {
+    QList<QPair<QString, QString>> applied;
     for(const auto& [bytes, name] :externalLoaders()) {
         if( m_flags & FigmaQml::LoaderPlaceHolders) {
-            emit externalLoadersApplied(name, "qrc:///LoaderPlaceHolder.qml");
+            applied.append({name, "qrc:///LoaderPlaceHolder.qml"});
         } else {
             const auto component_name = FigmaQml::validFileName("placeholder_" + name + FIGMA_SUFFIX);
             writeQmlFile(component_name, bytes, makeHeader());
-            emit externalLoadersApplied(name, component_name + ".qml");
+            applied.append({name, component_name + ".qml"});
         }
     }
+    flushOutput(); // placeholders are loaded when applied
+    for(const auto& [name, source] : applied)
+        emit externalLoadersApplied(name, source);
 }
 
 
@@ -425,19 +576,7 @@ QStringList FigmaQml::components() const {
 QStringList FigmaQml::components(int canvas_index, int element_index) const {
     if(m_sourceDoc && !m_sourceDoc->empty()) {
         const auto key = (*(m_sourceDoc->begin() + canvas_index))->name(element_index);
-        const auto component_list = m_sourceDoc->components(key);
-        for(const auto& c : component_list) {
-            const auto name_s = qmlTargetDir() + '/' + c + ".qml";
-#if 0            // look for this solution, have element subcomponents in their own folders...
-            const auto name_l = qmlTargetDir() + '/' + c + ".qml";
-            Q_ASSERT(QFileInfo::exists(name_l) || QFileInfo::exists(name_s));
-#else
-            Q_ASSERT(QFileInfo::exists(name_s));
-#endif
-            Q_ASSERT(!m_sourceDoc->component(c).isEmpty());
-            Q_ASSERT(!m_sourceDoc->componentObject(c).isEmpty());
-        }
-        return component_list;
+        return m_sourceDoc->components(key); // written files are verified on write
     } else {
         return QStringList();
     }
@@ -458,14 +597,130 @@ void FigmaQml::cancel() {
 
 void FigmaQml::doCancel() {
     m_doCancel = true;
+    abortDocument();
+    // files not written are written again when generated
+    const auto dropped = m_writer->cancel();
+    for(const auto& fileName : dropped)
+        m_hashes.remove(fileName);
+    if(!dropped.isEmpty()) {
+        const QSet<QString> droppedFiles(dropped.cbegin(), dropped.cend());
+        m_imageFiles.removeIf([&droppedFiles](const std::pair<const QString&, QPair<QString, QString>&>& file) {return droppedFiles.contains(file.second.first + file.second.second);});
+    }
     m_busy = false;
     emit busyChanged();
 }
 
+// parser polls this
+bool FigmaQml::isCancelled() {
+    return m_doCancel;
+}
+
+// An interactive construction runs in time slices: when a slice is used, the construction is suspended
+// between nodes and continued from the next node, meanwhile events (e.g. cancel) are handled.
+bool FigmaQml::sliceUsed() {
+    if(!m_lazy || !m_yieldTimer.isValid() || m_yieldTimer.elapsed() < CancelLatency.count())
+        return false;
+    m_yielded = true;
+    suspend();
+    return true;
+}
+
+// calls that would change the state are deferred while the event processing is nested within generateSource,
+// the ongoing operation gets cancelled
+bool FigmaQml::deferred(const std::function<void ()>& call) {
+    if(!m_yielding)
+        return false;
+    doCancel();
+    QTimer::singleShot(0, this, call);
+    return true;
+}
+
+// stop a document generation in progress, a new one pre-empts it
+void FigmaQml::abortDocument() {
+    if(m_createTimer) {
+        m_createTimer->stop();
+        m_createTimer->deleteLater();
+    }
+    m_createTimer = nullptr;
+    mRestore = nullptr;
+}
+
 void FigmaQml::setFilter(const QMap<int, QSet<int>>& filter) {
     m_filter = filter;
 }
 
+void FigmaQml::setFilter(const QStringList& pages, const QStringList& frames) {
+    m_pageSelection = pages;
+    m_frameSelection = frames;
+}
+
+// canvas and element indices start from 1
+bool FigmaQml::isFiltered(int canvasIndex, int elementIndex) const {
+    if(m_filter.isEmpty())
+        return false;
+    const auto it = m_filter.find(canvasIndex);
+    return it == m_filter.end() || !it->contains(elementIndex);
+}
+
+bool FigmaQml::applySelection(const FigmaParser::Canvases& canvases) {
+    if(m_pageSelection.isEmpty() && m_frameSelection.isEmpty())
+        return true;
+    const auto matches = [](const QString& selector, int index, const QString& name, const QString& id) {
+        bool isNumber = false;
+        const auto number = selector.toInt(&isNumber);
+        return isNumber ? number == index : (selector == name || selector == id);
+    };
+    QMap<int, QSet<int>> filter;
+    QSet<QString> found;
+    int canvasIndex = 0;
+    for(const auto& c : canvases) {
+        ++canvasIndex;
+        bool pageSelected = m_pageSelection.isEmpty();
+        for(const auto& selector : m_pageSelection) {
+            if(matches(selector, canvasIndex, c.name(), c.id())) {
+                found.insert(selector);
+                pageSelected = true;
+            }
+        }
+        if(!pageSelected)
+            continue;
+        int elementIndex = 0;
+        for(const auto& e : c.elements()) {
+            ++elementIndex;
+            bool frameSelected = m_frameSelection.isEmpty();
+            for(const auto& selector : m_frameSelection) {
+                if(matches(selector, elementIndex, e["name"].toString(), e["id"].toString())) {
+                    found.insert(selector);
+                    frameSelected = true;
+                }
+            }
+            if(frameSelected)
+                filter[canvasIndex].insert(elementIndex);
+        }
+    }
+    for(const auto& selector : m_pageSelection + m_frameSelection) {
+        if(!found.contains(selector)) {
+            parseError(toStr("Page or frame not found:", selector), true);
+            return false;
+        }
+    }
+    if(filter.isEmpty()) {
+        parseError("Nothing selected", true);
+        return false;
+    }
+    m_filter = filter;
+    return true;
+}
+
+void FigmaQml::setLazy(bool lazy) {
+    m_lazy = lazy;
+}
+
+void FigmaQml::setStreaming(bool streaming) {
+    m_streaming = streaming;
+    m_lazy = streaming;
+}
+
 QByteArray FigmaQml::prettyData(const QByteArray& data) const {
     if(data.isEmpty()) {
         //emit const_cast<FigmaQml*>(this)->error("No data");
@@ -482,12 +737,22 @@ QByteArray FigmaQml::prettyData(const QByteArray& data) const {
     return bytes;
 }
 
+static std::optional<quint64> fileHash(const QString& filename) {
+    QFile f(filename);
+    if(!f.open(QFile::ReadOnly))
+        return std::nullopt;
+    return hash64(f.readAll());
+}
+
 // folder is more of prefix...
 std::optional<QStringList> FigmaQml::saveImages(const QString &folder, const QSet<QString>& filter) const {
-    if(!ensureDirExists(folder))
+    if(!flushOutput() || !ensureDirExists(folder)) // images are linked from the written files
         return std::nullopt;
     QStringList img_list;
+    QSet<QString> saved;
     for(const auto& [k, i] : m_imageFiles.asKeyValueRange()) {
+        if(m_doCancel)
+            return std::nullopt;
         if(!filter.empty()) {
             if(m_imageContexts.contains(k)) {
                 const auto awhat = m_imageContexts[k];
@@ -499,30 +764,30 @@ std::optional<QStringList> FigmaQml::saveImages(const QString &folder, const QSe
                      continue; // filter out
             }
         }
-        const QFileInfo file(i.first + i.second);
-        if(!file.exists()) {
-            qDebug() << "invalid file name:" << file.absoluteFilePath() << "not found";
-            emit error(QString("Invalid filename: %1 (not found)").arg(file.absoluteFilePath()));
+        if(saved.contains(i.second))
+            continue; // duplicate image, shares the file
+        saved.insert(i.second);
+        const auto target = folder + i.second;
+        img_list.append(target);
+        // written straight from the memory
+        const auto bytes = m_imageData.value(i.second);
+        if(bytes.isEmpty()) {
+            emit error(QString("Cannot write %1, image data of %2 is not available").arg(target, k));
             return std::nullopt;
         }
-        const auto target = folder + file.fileName();
-        img_list.append(target);
-        const QFile targetEntry(target);
-        if(targetEntry.exists(target)) {
-            if(targetEntry.size() == file.size()) {
-                // I dont fully get what this means.... how they can be same, error elsewhere?
-                emit warning(QString("Are equal %1 to %2").arg(file.absoluteFilePath(), target));
-                continue;
-             } else {
-                emit error(QString("Cannot replace %1 to %2").arg(file.absoluteFilePath(), target));
+        const QFileInfo targetInfo(target);
+        if(targetInfo.exists()) {
+            if(targetInfo.size() == bytes.size() && fileHash(target) == hash64(bytes))
+                continue; // already there
+            if(!QFile::remove(target)) {
+                emit error(QString("Cannot replace %1").arg(target));
                 return std::nullopt;
             }
         }
-        if(!QFile::copy(file.absoluteFilePath(), target)) {
-            emit error(QString("Cannot copy %1 to %2").arg(file.absoluteFilePath(), target));
-            return std::nullopt;
-        }
+        m_writer->write(target, bytes, OutputWriter::Mode::Durable);
     }
+    if(!flushOutput())
+        return std::nullopt;
     return std::make_optional(img_list);
 }
 
@@ -547,6 +812,35 @@ bool FigmaQml::addImageFileData(const QString& imageRef, const QByteArray& bytes
         return false;
 
     const auto path = qmlTargetDir() + Images.mid(1);
+    // the same bitmap may have several imageRefs and renderings, they refer to a single file
+    const auto hash = hash64(bytes);
+    const auto same = m_imageNames.constFind(hash);
+    if(same != m_imageNames.constEnd()) {
+        if(!m_imageFiles.contains(imageRef)) {
+            m_imageFiles.insert(imageRef, {path, *same});
+            const auto clip = m_atlasRects.constFind(hash);
+            if(clip != m_atlasRects.constEnd())
+                m_imageClips.insert(imageRef, *clip);
+            m_duplicateImageBytes += bytes.size();
+        }
+        return true;
+    }
+    // small images are packed into atlas, not supported by Qt for MCUs
+    QBuffer imageBuffer;
+    imageBuffer.setData(bytes);
+    if((m_flags & AtlasImages) && !(m_flags & QulMode) && ImageAtlas::fits(QImageReader(&imageBuffer).size())) {
+        if(!m_atlas)
+            m_atlas = std::make_unique<ImageAtlas>();
+        const auto placement = m_atlas->add(QImage::fromData(bytes));
+        if(placement) {
+            const auto fileName = ImageAtlas::fileName(placement->page);
+            m_imageFiles.insert(imageRef, {path, fileName});
+            m_imageNames.insert(hash, fileName);
+            m_imageClips.insert(imageRef, placement->rect);
+            m_atlasRects.insert(hash, placement->rect);
+            return true;
+        }
+    }
     int count = 1;
     static const QRegularExpression re(R"([\\\/:*?"<>|\s;])");
     auto name = imageRef;
@@ -558,23 +852,59 @@ bool FigmaQml::addImageFileData(const QString& imageRef, const QByteArray& bytes
         imageName = QString("%1_%2.%3").arg(name).arg(count).arg(extension);
         ++count;
         }
-    ensureDirExists(path);
     const auto iname = path + imageName;
-    const auto filename = uniqueFilename(iname, bytes);
-    if(filename) {
-        QSaveFile file(*filename);
-        if(!file.open(QIODevice::WriteOnly)) {
-            emit warning("error when write:" + imageRef + " " +  *filename + " " + file.errorString());
-            return false;
-        }
-        //qDebug() << "image saved" << imageRef << filename;
-        file.write(bytes);
-        file.commit();
-        m_imageFiles.insert(imageRef, {path, imageName});
-    }
+    QString existing;
+    const auto filename = uniqueFilename(iname, bytes, &existing);
+    const auto fileName = QFileInfo(filename.value_or(existing)).fileName(); // may be renamed
+    // kept in the memory until exported, nothing reads them from the disk before that
+    m_imageData.insert(fileName, bytes);
+    m_imageFiles.insert(imageRef, {path, fileName});
+    m_imageNames.insert(hash, fileName);
     return true;
 }
 
+void FigmaQml::reportImageStats() const {
+    const auto duplicates = m_imageFiles.size() - m_imageNames.size();
+    if(duplicates > 0)
+        emit info(QString("%1 duplicate images share a file, %2 bytes saved").arg(duplicates).arg(m_duplicateImageBytes));
+    if(m_atlas)
+        emit info(QString("%1 images packed into %2 atlas textures, fill rate %3%")
+                  .arg(m_atlas->images()).arg(m_atlas->pages()).arg(m_atlas->fillRate() * 100., 0, 'f', 1));
+}
+
+// atlas pages are encoded once the images of a generation are packed
+void FigmaQml::writeAtlas() {
+    if(!m_atlas)
+        return;
+    for(const auto page : m_atlas->takeDirty())
+        m_imageData.insert(ImageAtlas::fileName(page), m_atlas->encoded(page));
+}
+
+void FigmaQml::clearImageFiles() {
+    m_imageFiles.clear();
+    m_imageNames.clear();
+    m_imageData.clear();
+    m_duplicateImageBytes = 0;
+    m_atlas.reset();
+    m_imageClips.clear();
+    m_atlasRects.clear();
+}
+
+// only image files are packed, embedded and provided images are not
+std::optional<QRect> FigmaQml::imageClip(const QString& imageRef) const {
+    if(m_embedImages || m_providedImages)
+        return std::nullopt;
+    const auto it = m_imageClips.constFind(imageRef);
+    return it != m_imageClips.constEnd() ? std::make_optional(*it) : std::nullopt;
+}
+
+bool FigmaQml::flushOutput() const {
+    const auto errors = m_writer->flush();
+    for(const auto& e : errors)
+        emit error(e);
+    return errors.isEmpty();
+}
+
 bool FigmaQml::ensureDirExists(const QString& e) const {
      QDir dir(e);
      if(!dir.mkpath(".")) {
@@ -602,21 +932,40 @@ void FigmaQml::setFonts(const QVariantMap& map) {
 
 template<class FigmaDocType>
 void FigmaQml::createDocument(const QJsonObject& json) {
+    m_nodeCache->nextRevision();
+    loadFontCache();
     m_state = State::Suspend;
+    m_doCancel = false;
     m_busy = true;
     emit busyChanged();
     auto ctimer = new QTimer(this);
-    QObject::connect(ctimer, &QTimer::timeout, this, [ctimer, this, json](){
+    m_createTimer = ctimer;
+    // the document tree is released when created, pending elements share only their own subtrees
+    const auto root = std::make_shared<QJsonObject>(json);
+    // a suspended construction is continued with the same document
+    const auto doc = std::make_shared<std::unique_ptr<FigmaDocType>>(std::make_unique<FigmaDocType>(qmlTargetDir(), FigmaParser::name(json), *m_writer, m_qmlStore.get()));
+    const auto lazy = std::make_shared<std::unique_ptr<LazyState>>(m_lazy ? std::make_unique<LazyState>() : nullptr);
+    const auto construction = std::make_shared<Construction>();
+    QObject::connect(ctimer, &QTimer::timeout, this, [ctimer, this, root, doc, lazy, construction](){
+        const auto& json = *root;
         if(m_state == State::Suspend) {
-            if(mProvider.isReady()) {
+            if(mProvider.isReady() && m_fontScan.isFinished()) {
                 m_state = State::Constructing;
-
-                auto doc = std::make_unique<FigmaDocType>(qmlTargetDir(), FigmaParser::name(json));
-                if(doCreateDocument(*doc, json)) {
+                m_yielded = false;
+                if(doCreateDocument(**doc, json, lazy->get(), *construction)) {
                     ctimer->stop();
                     ctimer->deleteLater();
-                    Q_ASSERT(FigmaDocType::type() == doc->type());
-                    emit figmaDocumentCreated(doc.release());
+                    *root = QJsonObject();
+                    *construction = Construction();
+                    Q_ASSERT(FigmaDocType::type() == (*doc)->type());
+                    if constexpr (std::is_same_v<FigmaDocType, FigmaFileDocument>)
+                        m_lazyView = std::move(*lazy);
+                    else
+                        m_lazySource = std::move(*lazy);
+                    saveFontCache();
+                    writeAtlas();
+                    flushOutput();
+                    emit figmaDocumentCreated(doc->release());
                 } else if(m_state != State::Suspend) {
                     parseError(FigmaParser::lastError(), true);
                 }
@@ -624,6 +973,7 @@ void FigmaQml::createDocument(const QJsonObject& json) {
                     m_busy = false;
                     emit busyChanged();
                 }
+                ctimer->setInterval(m_yielded ? 0 : 500); // continue a sliced construction immediately
             }
         } else {
             ctimer->stop();
@@ -640,15 +990,16 @@ QString FigmaQml::qmlTargetDir() const {
 
 
 void FigmaQml::createDocumentView(const QByteArray &data, bool restoreView) {
-
-    if(mRestore)
+    if(deferred([this, data, restoreView]() {createDocumentView(data, restoreView);}))
         return;
+    abortDocument(); // the latest request pre-empts the ongoing one
     const auto json = object(data);
     if(!json)
         return;
 
     reset(restoreView, true, true, true);
     m_embedImages = true;
+    m_providedImages = m_hasImageProvider;
 
     const auto restoredCanvas = currentCanvas();
     const auto restoredElement = currentElement();
@@ -670,6 +1021,7 @@ void FigmaQml::createDocumentView(const QByteArray &data, bool restoreView) {
 
 void FigmaQml::setFontMapping(const QString& key, const QString& value) {
     qDebug() << "set font" << key << "->" << value;
+    registerFolderFont(value);
     m_fontCache->insert(key, value);
     emit refresh();
     emit fontsChanged();
@@ -683,12 +1035,16 @@ void FigmaQml::resetFontMappings() {
 
 
 void FigmaQml::createDocumentSources(const QByteArray &data) {
+    if(deferred([this, data]() {createDocumentSources(data);}))
+        return;
     const auto json = object(data);
     if(!json)
         return;
 
     m_sourceDoc.reset();
+    m_lazySource.reset();
     m_embedImages = m_flags & EmbedImages;
+    m_providedImages = false;
 
     createDocument<FigmaDataDocument>(*json);
 
@@ -739,26 +1095,26 @@ QString FigmaQml::nearestFontFamily(const QString& requestedFont, bool useAlt) {
         const auto value = fontInfo.family();
         return value;
     } else {
+        // index is rebuilt only when fonts are added
+        static std::unique_ptr<FontIndex> index;
+        static unsigned indexGeneration = 0;
+        QMutexLocker lock(&FontIndexMutex);
+        if(!index || indexGeneration != FontGeneration) {
 #ifdef QT5
-        QFontDatabase fdb;
-        const QStringList fontFamilies = fdb.families();
+            QFontDatabase fdb;
+            QStringList fontFamilies = fdb.families();
 #else
-        const QStringList fontFamilies = QFontDatabase::families();
+            QStringList fontFamilies = QFontDatabase::families();
 #endif
-        int min = std::numeric_limits<int>::max();
-        int index = -1;
-        for(auto ff = 0; ff < fontFamilies.size() ; ff++) {
-            const auto distance = levenshteinDistance(fontFamilies[ff], requestedFont);
-            if(distance < min) {
-                index = ff;
-                min = distance;
+            const QSet<QString> installed(fontFamilies.cbegin(), fontFamilies.cend());
+            for(const auto& family : FolderFamilies) {
+                if(!installed.contains(family))
+                    fontFamilies.append(family);
             }
+            index = std::make_unique<FontIndex>(fontFamilies);
+            indexGeneration = FontGeneration;
         }
-        if(index < 0) {
-            return requestedFont;
-        }
-        const auto value = fontFamilies[index];
-        return value;
+        return index->nearest(requestedFont).value_or(requestedFont);
     }
 }
 
@@ -812,6 +1168,8 @@ QByteArray FigmaQml::imageData(const QString& imageRef, bool isRendering) {
             const auto& [bytes, mime] = imageData.value();
             if(bytes.isEmpty())
                 return QByteArray();
+            if(m_providedImages)
+                return FigmaImageProvider::url(imageRef, isRendering, m_imageRevision);
             Q_ASSERT(mime == JPEG || mime == PNG);
             const QByteArray mimeString = mime == JPEG ? "jpeg" : "png";
             return "data:image/" + mimeString + ";base64," + bytes.toBase64();
@@ -844,15 +1202,107 @@ QByteArray FigmaQml::nodeData(const QString& id) {
 }
 
 QString FigmaQml::fontInfo(const QString& requestedFont) {
+    const auto value = resolveFont(requestedFont);
+    m_usedFonts.insert(requestedFont, value);
+    return value;
+}
+
+QString FigmaQml::resolveFont(const QString& requestedFont) {
     if(m_flags & KeepFigmaFontName)
         return requestedFont;
-    if(m_fontCache->contains(requestedFont))
-        return (*m_fontCache)[requestedFont];
+    registerFolderFont(requestedFont);
+    if(m_fontCache->contains(requestedFont)) {
+        const auto value = (*m_fontCache)[requestedFont];
+        registerFolderFont(value);
+        return value;
+    }
     const auto value = nearestFontFamily(requestedFont, m_flags & AltFontMatch);
-    m_fontCache->insert(requestedFont, value);
+    registerFolderFont(value); // may be a folder font
+    m_fontCache->insertResolved(requestedFont, value);
     return value;
 }
 
+// all folder fonts e.g. to choose from
+void FigmaQml::registerFolderFonts() {
+    const auto families = QSet<QString>(m_folderFonts.keyBegin(), m_folderFonts.keyEnd());
+    for(const auto& family : families)
+        registerFolderFont(family);
+}
+
+void FigmaQml::registerFolderFont(const QString& family) {
+    if(m_folderFonts.isEmpty())
+        return;
+    const auto files = m_folderFonts.values(family.toLower()) + m_folderFonts.values(FontIndex::normalized(family));
+    for(const auto& file : files) {
+        if(m_registeredFonts.contains(file))
+            continue;
+        m_registeredFonts.insert(file);
+        const auto id = QFontDatabase::addApplicationFont(file);
+        if(id >= 0)
+            fontsChanged();
+        const auto families = QFontDatabase::applicationFontFamilies(id);
+        if(id < 0 || families.isEmpty()) {
+            emit warning(QString("Font \"%1\", cannot be loaded").arg(file));
+            continue;
+        }
+        for(const auto& f : families)
+            m_folderFamilies.insert(f);
+        const QFont font(families);
+        emit info("font \"" + QFileInfo(file).fileName() + "\" loaded");
+        qDebug() << "Font" << file << "loaded "<< font;
+        emit fontLoaded(font);
+    }
+}
+
+// resolved fonts are valid as long as the installed fonts are the same
+QByteArray FigmaQml::fontState() const {
+#ifdef QT5
+    QFontDatabase fdb;
+    const auto installed = fdb.families();
+#else
+    const auto installed = QFontDatabase::families();
+#endif
+    // the folder fonts are added when used, the folder listing below covers them
+    QStringList families;
+    for(const auto& family : installed) {
+        if(!m_folderFamilies.contains(family))
+            families.append(family);
+    }
+    auto state = families.join('\n');
+    if(!m_fontFolder.isEmpty()) {
+        for(const auto& entry : QDir(m_fontFolder).entryInfoList(QDir::Files, QDir::Name))
+            state += QString("\n%1;%2;%3").arg(entry.fileName()).arg(entry.size()).arg(entry.lastModified().toMSecsSinceEpoch());
+    }
+    return state.toUtf8();
+}
+
+static QString fontCacheFile(const QByteArray& fontState, bool altFontMatch) {
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + FontCachePath
+            + QString::number(hash64(fontState + (altFontMatch ? "\nalt" : "\nqt")), 16);
+}
+
+void FigmaQml::loadFontCache() {
+    if(m_flags & KeepFigmaFontName)
+        return;
+    const auto fileName = fontCacheFile(fontState(), m_flags & AltFontMatch);
+    if(fileName != m_fontCacheFile) // resolved with other fonts
+        m_fontCache->clearResolved();
+    m_fontCacheFile = fileName;
+    m_fontCache->load(m_fontCacheFile);
+    // the least recently used files are removed, other runs may use other fonts
+    QFile current(m_fontCacheFile);
+    if(current.exists() && current.open(QIODevice::ReadWrite))
+        current.setFileTime(QDateTime::currentDateTime(), QFileDevice::FileModificationTime);
+    auto entries = QDir(QFileInfo(m_fontCacheFile).absolutePath()).entryInfoList(QDir::Files, QDir::Time);
+    while(entries.size() > FontCacheFiles)
+        QFile::remove(entries.takeLast().absoluteFilePath());
+}
+
+void FigmaQml::saveFontCache() {
+    if(!m_fontCacheFile.isEmpty() && !m_fontCache->save(m_fontCacheFile))
+        emit warning(QString("Cannot save font cache %1").arg(m_fontCacheFile));
+}
+
 bool FigmaQml::writeQmlFile(const QString& component_name, const QByteArray& element_data, const QByteArray& header, const QString& subFolder) {
     Q_ASSERT(subFolder.isEmpty()); // this is for future thinking, it is very bad that components get overwritten!
     Q_ASSERT(component_name.endsWith(FIGMA_SUFFIX));
@@ -861,27 +1311,29 @@ bool FigmaQml::writeQmlFile(const QString& component_name, const QByteArray& ele
     const QString qname = qmlTargetDir() + (!subFolder.isEmpty() ? subFolder + '/' : QString{}) + component_name + ".qml";
     const auto content = header + element_data;
     const auto filename = uniqueFilename(qname, content);
-    if(filename) {
-        QDir().mkpath((QFileInfo(*filename).path()));
-        QSaveFile componentFile(*filename);
-        if(!componentFile.open(QIODevice::WriteOnly)) {
-            emit error(toStr("Cannot write", *filename, componentFile.errorString()));
-            return false;
-        }
-        componentFile.write(content);
-        componentFile.commit();
-    }
+    if(filename && m_qmlStore)
+        m_qmlStore->insert(QFileInfo(*filename).fileName(), content);
+    else if(filename)
+        m_writer->write(*filename, content); // errors are reported on flush
     return true;
 }
 
 
-bool FigmaQml::writeComponents(FigmaDocument& doc, const FigmaParser::Components& components, const QByteArray& header) {
+bool FigmaQml::writeComponents(FigmaDocument& doc, Construction& construction) {
     qDebug() << "write componets!";
-    for(const auto& c : components) {
+    const auto& components = *construction.components;
+    const auto& header = construction.header;
+    for(const auto& [key, c] : components.asKeyValueRange()) {
+      if(construction.writtenComponents.contains(key))
+          continue; // written before the construction was suspended
+      if(sliceUsed())
+          return false;
 
-      const auto component_opt = FigmaParser::component(c->object(), m_flags, *this, components);
+      const auto component_opt = makeElement(c->object(), components, true);
       if(!m_ok || m_doCancel || !component_opt)
           return false;
+      if(m_state == State::Suspend)
+          continue; // waits data, the rest still requests theirs
       const auto& component = component_opt.value();
       if(component.data().isEmpty()) {
           emit error(toStr("Invalid component", component.name()));
@@ -908,6 +1360,7 @@ bool FigmaQml::writeComponents(FigmaDocument& doc, const FigmaParser::Components
 
       const auto subs = component.subComponents();
       for(const auto& [sub_name, sub_data] : subs.asKeyValueRange()) {
+          componentNames.append(sub_name);
           const auto data = header + std::get<QByteArray>(sub_data);
           doc.addComponent(sub_name, std::get<QJsonObject>(sub_data), data);
           //if(std::get<QString>(sub_data).isEmpty()) {
@@ -917,6 +1370,8 @@ bool FigmaQml::writeComponents(FigmaDocument& doc, const FigmaParser::Components
               }
           //}
       }
+      // components used by components, the closure and order of the document follow these
+      doc.setComponents(components[component.id()]->name(), componentNames);
 
       m_externalLoaders.insert(component.externalLoaders());
 
@@ -925,53 +1380,105 @@ bool FigmaQml::writeComponents(FigmaDocument& doc, const FigmaParser::Components
           emit error(toStr("Cannot write component", component.name()));
           return false;
       }
+      construction.writtenComponents.insert(key);
+    }
+    return m_state != State::Suspend;
+}
+
+
+std::optional<FigmaParser::Element> FigmaQml::makeElement(const QJsonObject& obj, const FigmaParser::Components& components, bool isComponent) {
+    const auto id = obj["id"].toString();
+    // the registry name depends on the other nodes, a node is reused only with the same name
+    const auto hash = NodeCache::hash(obj) + uniqueName(id, obj["name"].toString()).toUtf8();
+    const auto accept = [this](const FigmaParser::Element& element) {return restoreImages(element);};
+    const auto cached = isComponent ? m_nodeCache->component(id, hash, accept) : m_nodeCache->element(id, hash, accept);
+    if(cached)
+        return *cached;
+    m_usedFonts.clear();
+    auto element = isComponent ?
+                FigmaParser::component(obj, m_flags, *this, components) :
+                FigmaParser::element(obj, m_flags, *this, components);
+    if(element && m_ok && !m_doCancel && m_state != State::Suspend) {
+        if(isComponent)
+            m_nodeCache->insertComponent(id, hash, *element, m_usedFonts);
+        else
+            m_nodeCache->insertElement(id, hash, *element, m_usedFonts);
+    }
+    return element;
+}
 
+// reused element refers to image files, ensure they are there
+bool FigmaQml::restoreImages(const FigmaParser::Element& element) {
+    if(m_providedImages) {
+        // provider serves the images from the cache, they must be still there
+        for(const auto& imageRef : element.imageContexts()) {
+            if(imageRef != FigmaParser::PlaceHolder && !mProvider.cachedImage(imageRef) && !mProvider.cachedRendering(imageRef))
+                return false;
+        }
+        return true;
+    }
+    if(m_embedImages)
+        return true;
+    for(const auto& imageRef : element.imageContexts()) {
+        if(imageRef == FigmaParser::PlaceHolder)
+            continue;
+        if(!m_imageFiles.contains(imageRef)) {
+            auto imageData = mProvider.cachedImage(imageRef);
+            if(!imageData)
+                imageData = mProvider.cachedRendering(imageRef);
+            if(!imageData)
+                return false;
+            const auto& [bytes, mime] = imageData.value();
+            if(!addImageFileData(imageRef, bytes, mime) || !m_imageFiles.contains(imageRef))
+                return false;
+        }
+        if(!element.data().contains((Images.mid(1) + m_imageFiles[imageRef].second).toLatin1()))
+            return false;
+        const auto clip = m_imageClips.constFind(imageRef);
+        if(clip != m_imageClips.constEnd() && !element.data().contains(FigmaParser::makeClipRect(*clip)))
+            return false;
     }
     return true;
 }
 
+bool FigmaQml::setDocument(FigmaDocument& doc, Construction& construction, LazyState* lazy) {
+    const auto& canvases = *construction.canvases;
+    const auto& components = *construction.components;
+    const auto& header = construction.header;
 
-bool FigmaQml::setDocument(FigmaDocument& doc,
-                           const FigmaParser::Canvases& canvases,
-                           const FigmaParser::Components& components,
-                           const QByteArray& header) {
-    int currentCanvas = 0;
-
-    int currentElement = 0;
-
-    for(const auto& c : canvases) {
-        ++currentCanvas;
-        currentElement = 0;
-        auto canvas = doc.addCanvas(c.name());
+    // continued from where a suspended construction stopped
+    for(; construction.canvas < static_cast<int>(canvases.size()); ++construction.canvas, construction.element = 0) {
+        const auto& c = canvases[static_cast<size_t>(construction.canvas)];
+        const int currentCanvas = construction.canvas + 1;
+        const auto canvas = doc.size() > construction.canvas ? (doc.begin() + construction.canvas)->get() : doc.addCanvas(c.name());
 
         const auto elements = c.elements();
 
         qDebug() << "write elements";
 
-        for(const auto& f : elements) {
+        for(; construction.element < static_cast<int>(elements.size()); ++construction.element) {
+            const auto& f = elements[static_cast<size_t>(construction.element)];
             if(m_state == State::Suspend)
                 return false;
             if(m_doCancel)
                 return false;
-            bool hasElement = true;
-            if(!m_filter.isEmpty()) {
-                ++currentElement;
-                const auto keys = m_filter.keys();
-                if(!keys.contains(currentCanvas) || !m_filter[currentCanvas].contains(currentElement))
-                    hasElement = false;
+            const int currentElement = construction.element + 1;
+            const bool hasElement = !isFiltered(currentCanvas, currentElement);
+
+            if(hasElement && lazy) {
+                // generated when viewed, see generatePending
+                lazy->pending.insert({currentCanvas - 1, canvas->size()}, f);
+                canvas->addElement(uniqueName(f["id"].toString(), f["name"].toString()), header + "Text{text: \"loading...\"}");
+                continue;
             }
 
-            const auto element_opt = hasElement ? FigmaParser::element(f, m_flags, *this, components) : FigmaParser::Element();
+            if(hasElement && sliceUsed())
+                return false;
+            const auto element_opt = hasElement ? makeElement(f, components, false) : FigmaParser::Element();
             if(!element_opt)
                 return false;
             const auto& element = element_opt.value();
 
-            const auto images = element.imageContexts();
-            for(const auto& im : images) {
-                if(!m_imageContexts.contains(im))
-                    m_imageContexts.insert(im, {});
-                m_imageContexts[im].insert(element.name());
-            }
             if(m_state == State::Suspend)
                 return false;
 
@@ -980,31 +1487,199 @@ bool FigmaQml::setDocument(FigmaDocument& doc,
             if(!m_ok) {
                 return false;
             }
-            if(!element.data().isEmpty())
-                canvas->addElement(element.name(), header + element.data());
-            else
-                canvas->addElement(element.name(), header + "Text{text: \"filtered out\"}");
-            QStringList componentNames;
-            for(const auto& id : element.components()) {
-                componentNames.append(components[id]->name());
-            }
+            if(!addElement(doc, *canvas, element.name(), -1, element, components, header))
+                return false;
+        }
+    }
+    return true;
+}
 
-            m_externalLoaders.insert(element.externalLoaders());
-
-            // this is bit confusing, the component owned sub componets are written before this function is called,
-            // but as element owned has to be called elsewhere it happens here. Whole this when is written and parsed
-            // what is confusing
-            for(const auto& [sub_name, sub_data] : element.subComponents().asKeyValueRange()) {
-                componentNames.append(sub_name);
-                const auto data = header + std::get<QByteArray>(sub_data);
-                doc.addComponent(sub_name, std::get<QJsonObject>(sub_data), data);
-                //if(std::get<QString>(sub_data).isEmpty()) {
-                    if(!writeQmlFile(sub_name, data, header/*, element.name()*/))
-                        return false;
-                //}
-            }
-            doc.setComponents(element.name(), std::move(componentNames));
+bool FigmaQml::addElement(FigmaDocument& doc, FigmaDocument::Canvas& canvas, const QString& name, int index,
+                          const FigmaParser::Element& element, const FigmaParser::Components& components, const QByteArray& header) {
+    const auto images = element.imageContexts();
+    for(const auto& im : images) {
+        if(!m_imageContexts.contains(im))
+            m_imageContexts.insert(im, {});
+        m_imageContexts[im].insert(name);
+    }
+
+    const auto data = !element.data().isEmpty() ? header + element.data() : header + "Text{text: \"filtered out\"}";
+    if(index < 0)
+        canvas.addElement(name, data);
+    else if(!canvas.setElement(index, data))
+        return false;
+
+    QStringList componentNames;
+    for(const auto& id : element.components()) {
+        componentNames.append(components[id]->name());
+    }
+
+    m_externalLoaders.insert(element.externalLoaders());
+
+    // this is bit confusing, the component owned sub componets are written before this function is called,
+    // but as element owned has to be called elsewhere it happens here. Whole this when is written and parsed
+    // what is confusing
+    for(const auto& [sub_name, sub_data] : element.subComponents().asKeyValueRange()) {
+        componentNames.append(sub_name);
+        const auto data = header + std::get<QByteArray>(sub_data);
+        doc.addComponent(sub_name, std::get<QJsonObject>(sub_data), data);
+        //if(std::get<QString>(sub_data).isEmpty()) {
+            if(!writeQmlFile(sub_name, data, header/*, element.name()*/))
+                return false;
+        //}
+    }
+    doc.setComponents(name, std::move(componentNames));
+    return true;
+}
+
+// returns false if the element cannot be generated now, i.e. it has to wait data to be fetched
+bool FigmaQml::generatePending(FigmaDocument* doc, LazyState* lazy, int canvasIndex, int elementIndex) {
+    if(!doc || !lazy)
+        return true;
+    const auto it = lazy->pending.constFind({canvasIndex, elementIndex});
+    if(it == lazy->pending.constEnd())
+        return true;
+    if(m_yielding || m_doCancel)
+        return false; // an other generation is ongoing, or cancelled
+
+    // a document may be under construction, its state is restored
+    const auto state = m_state;
+    const bool ok = m_ok;
+    const auto embedImages = m_embedImages;
+    const auto providedImages = m_providedImages;
+    const auto cacheContext = m_nodeCache->context();
+    const auto componentHashes = m_nodeCache->componentHashes();
+    m_state = State::Constructing;
+    m_ok = true;
+    m_embedImages = lazy->embedImages;
+    m_providedImages = lazy->providedImages;
+    m_nodeCache->restore(lazy->cacheContext, lazy->componentHashes);
+    RAII(([this, state, ok, embedImages, providedImages, cacheContext, componentHashes]() {
+        m_state = state;
+        m_ok = ok;
+        m_embedImages = embedImages;
+        m_providedImages = providedImages;
+        m_nodeCache->restore(cacheContext, componentHashes);
+    }));
+
+    const auto element = makeElement(*it, lazy->components, false);
+    if(m_state == State::Suspend || m_doCancel)
+        return false;
+
+    auto& canvas = **(doc->begin() + canvasIndex);
+    const auto name = canvas.name(elementIndex);
+    lazy->pending.erase(it);
+    if(!element || !m_ok) {
+        parseError(toStr("Cannot generate", name, FigmaParser::lastError()), true);
+        return true;
+    }
+
+    if(!addElement(*doc, canvas, name, elementIndex, *element, lazy->components, lazy->header))
+        emit error(toStr("Cannot write", name));
+    saveFontCache();
+    writeAtlas();
+    flushOutput(); // element can be viewed
+    return true;
+}
+
+void FigmaQml::generateCurrent() {
+    if(!m_uiDoc || m_uiDoc->empty())
+        return;
+    if(!m_yielding)
+        m_doCancel = false; // a new request
+    const auto canvasIndex = currentCanvas();
+    const auto elementIndex = currentElement();
+    const auto viewPending = m_lazyView && m_lazyView->pending.contains({canvasIndex, elementIndex});
+    const auto sourcePending = m_lazySource && m_lazySource->pending.contains({canvasIndex, elementIndex});
+    if(!viewPending && !sourcePending)
+        return;
+
+    const auto viewDone = generatePending(m_uiDoc.get(), m_lazyView.get(), canvasIndex, elementIndex);
+    const auto sourceDone = generatePending(m_sourceDoc.get(), m_lazySource.get(), canvasIndex, elementIndex);
+    if(viewPending && viewDone)
+        emit elementChanged();
+    if(sourcePending && sourceDone) {
+        emit sourceCodeChanged();
+        emit componentsChanged();
+    }
+
+    if(!viewDone || !sourceDone) {
+        // retry when data is received
+        QTimer::singleShot(FrameDelay, this, [this, canvasIndex, elementIndex]() {
+            if(canvasIndex == currentCanvas() && elementIndex == currentElement())
+                generateCurrent();
+        });
+        return;
+    }
+
+    QTimer::singleShot(0, this, [this, canvasIndex, elementIndex]() {
+        prefetch(canvasIndex, elementIndex + 1, true, false);
+    });
+}
+
+// generate in advance a node at the time, so events are handled in between. If data is
+// not available, the generation waits the element to be viewed
+void FigmaQml::prefetch(int canvasIndex, int elementIndex, bool next, bool source) {
+    // user has moved on
+    if(canvasIndex != currentCanvas() || std::abs(elementIndex - currentElement()) != 1)
+        return;
+    if(source)
+        generatePending(m_sourceDoc.get(), m_lazySource.get(), canvasIndex, elementIndex);
+    else
+        generatePending(m_uiDoc.get(), m_lazyView.get(), canvasIndex, elementIndex);
+    QTimer::singleShot(0, this, [this, canvasIndex, elementIndex, next, source]() {
+        if(!source)
+            prefetch(canvasIndex, elementIndex, next, true);
+        else if(next) // then the previous element
+            prefetch(canvasIndex, elementIndex - 2, false, false);
+    });
+}
+
+// ensure that all elements are generated, needed before writing
+bool FigmaQml::generateAll() {
+    if(m_yielding)
+        return false;
+    m_doCancel = false;
+    while(m_lazySource && !m_lazySource->pending.isEmpty()) {
+        const auto [canvasIndex, elementIndex] = m_lazySource->pending.constBegin().key();
+        if(!generateSource(canvasIndex, elementIndex))
+            return false;
+    }
+    return true;
+}
+
+// generate a source element, waits until its data is fetched. Gives up if a fetch fails or
+// no data is received within SourceTimeout
+bool FigmaQml::generateSource(int canvasIndex, int elementIndex) {
+    const auto source = m_sourceDoc.get();
+    bool failed = false;
+    QElapsedTimer idle;
+    idle.start();
+    const auto received = [&idle]() {idle.restart();};
+    const QList<QMetaObject::Connection> connections {
+        QObject::connect(&mProvider, &FigmaProvider::error, this, [&failed]() {failed = true;}),
+        QObject::connect(&mProvider, &FigmaProvider::imageReady, this, received),
+        QObject::connect(&mProvider, &FigmaProvider::renderingReady, this, received),
+        QObject::connect(&mProvider, &FigmaProvider::nodeReady, this, received)
+    };
+    RAII(([&connections]() {
+        for(const auto& c : connections)
+            QObject::disconnect(c);
+    }));
+    for(;;) {
+        if(generatePending(m_sourceDoc.get(), m_lazySource.get(), canvasIndex, elementIndex))
+            break;
+        if(failed || idle.elapsed() >= SourceTimeout.count()) {
+            emit error(toStr("Cannot generate", (*(m_sourceDoc->begin() + canvasIndex))->name(elementIndex), failed ? "data not received" : "timeout"));
+            return false;
         }
+        QEventLoop loop;
+        QTimer::singleShot(FrameDelay, &loop, &QEventLoop::quit);
+        m_yielding = true;
+        loop.exec();
+        m_yielding = false;
+        if(m_doCancel || source != m_sourceDoc.get())
+            return false;
     }
     return true;
 }
@@ -1042,69 +1717,117 @@ QByteArray FigmaQml::makeHeader() const {
     return header;
 }
 
-bool FigmaQml::doCreateDocument(FigmaDocument& doc, const QJsonObject& json) {
+bool FigmaQml::doCreateDocument(FigmaDocument& doc, const QJsonObject& json, LazyState* lazy, Construction& construction) {
     m_ok = true;
-    m_doCancel = false; // uff UniqueConnection requires a member func
-    const auto d = QObject::connect(this, &FigmaQml::cancelled, this,
-                                    &FigmaQml::doCancel, Qt::UniqueConnection);
+    m_yieldTimer.start();
+    RAII(([this](){m_yieldTimer.invalidate();}));
+
+    Q_ASSERT(m_imageDimensionMax > 0);
 
-    RAII(([d](){QObject::disconnect(d);}));
+    // the document wide work is done once, a suspended construction continues with the nodes
+    if(!construction.components) {
+        if(!ensureDirExists(qmlTargetDir()))
+           return false;
 
+        auto canvases = FigmaParser::canvases(json);
+        if(!canvases)
+            return false;
 
-    Q_ASSERT(m_imageDimensionMax > 0);
+        // names are given before anything is filtered, so they do not depend on the selection
+        m_names->index(json);
 
-    // erase 1st
-    QDir dir(qmlTargetDir());
-    const auto entries = dir.entryList();
-    if(!ensureDirExists(qmlTargetDir()))
-       return false;
+        if(!applySelection(*canvases))
+            return false;
 
+        // only the components used by the converted elements are fetched and generated
+        QSet<QString> roots;
+        int canvasIndex = 0;
+        for(const auto& c : *canvases) {
+            ++canvasIndex;
+            int elementIndex = 0;
+            for(const auto& e : c.elements()) {
+                ++elementIndex;
+                if(!isFiltered(canvasIndex, elementIndex))
+                    roots.unite(FigmaParser::componentDependencies(e));
+            }
+        }
 
+        // may be suspended to fetch nodes, then all is done again
+        const auto components = FigmaParser::components(json, *this, &roots);
 
-    const auto components = FigmaParser::components(json, *this);
+        if(!components || m_state == State::Suspend) {
+            return false;
+        }
 
-    if(!components) {
-        return false;
-    }
+        m_unusedComponents.clear();
+        const auto allComponents = json["components"].toObject();
+        for(auto it = allComponents.begin(); it != allComponents.end(); ++it) {
+            if(!components->contains(it.key()))
+                m_unusedComponents.append(uniqueName(it.key(), it.value().toObject()["name"].toString()));
+        }
 
-     TIMED_START(t3)
+        /*
+        const auto keys = components->keys();
+        for (const auto k : keys) {
+            qDebug().nospace()
+                    << k << ';'
+                    << (*components)[k]->id() << ';'
+                    << (*components)[k]->key() << ';'
+                    << (*components)[k]->name();
+        }
 
-    /*
-    const auto keys = components->keys();
-    for (const auto k : keys) {
-        qDebug().nospace()
-                << k << ';'
-                << (*components)[k]->id() << ';'
-                << (*components)[k]->key() << ';'
-                << (*components)[k]->name();
-    }
 
+        static int loopers = 0;
+        ++loopers;
+        const auto [i, r, n] = mProvider.cacheInfo();
+        qDebug() << "loopers" << loopers << i << r << n;
+        */
+
+        const auto header = makeHeader();
 
-    static int loopers = 0;
-    ++loopers;
-    const auto [i, r, n] = mProvider.cacheInfo();
-    qDebug() << "loopers" << loopers << i << r << n;
-    */
+        // header has version and imports, fonts are validated per node
+        const auto context = QCryptographicHash::hash(header
+                                                      + QByteArray::number(m_flags & ~NonCodeFlags) + ';'
+                                                      + QByteArray::number(m_embedImages) + ';'
+                                                      + QByteArray::number(m_providedImages ? m_imageRevision + 1 : 0) + ';'
+                                                      + QByteArray::number(m_imageDimensionMax), QCryptographicHash::Md5);
+        m_nodeCache->begin(context, *components);
+        m_yieldTimer.restart(); // a slice is spent on the nodes
 
-     const auto header = makeHeader();
+        construction.canvases = std::move(canvases);
+        construction.components = *components;
+        construction.header = header;
+    }
+
+     TIMED_START(t3)
 
-    if(!writeComponents(doc, *components, header)) {
+    if(!writeComponents(doc, construction)) {
         return false;
     }
 
     TIMED_END(t3, "Component")
     TIMED_START(t4)
 
+    if(lazy) {
+        lazy->components = *construction.components;
+        lazy->header = construction.header;
+        lazy->embedImages = m_embedImages;
+        lazy->providedImages = m_providedImages;
+        lazy->cacheContext = m_nodeCache->context();
+        lazy->componentHashes = m_nodeCache->componentHashes();
+    }
 
-    const auto canvases = FigmaParser::canvases(json);
-    if(!canvases)
-        return false;
-
-    if(!setDocument(doc, *canvases, *components, header)) {
+    if(!setDocument(doc, construction, lazy)) {
         return false;
     }
 
     TIMED_END(t4, "elements")
+
+    const auto& componentStats = m_nodeCache->componentStats();
+    const auto& elementStats = m_nodeCache->elementStats();
+    emit info(QString("Components %1 rebuilt, %2 reused. Elements %3 rebuilt, %4 reused.")
+              .arg(componentStats.rebuilt).arg(componentStats.reused)
+              .arg(elementStats.rebuilt).arg(elementStats.reused));
     return true;
 }
 
@@ -1126,7 +1849,11 @@ void FigmaQml::showFontDialog(const QString& currentFont) {
 
 void FigmaQml::executeQul(const QVariantMap& parameters, const QVector<int>& elements) {
 #if defined(HAS_QUL) && defined(HAS_EXECUTE)
-    AppWrite::executeQulApp(parameters, *this, elements);
+    if(!generateAll())
+        return;
+    auto qulParameters = parameters;
+    qulParameters.insert("qulPreconvertImages", (m_flags & QulPreconvertImages) != 0);
+    AppWrite::executeQulApp(qulParameters, *this, elements);
 #else
     (void) parameters;
     (void) elements;
@@ -1135,6 +1862,8 @@ void FigmaQml::executeQul(const QVariantMap& parameters, const QVector<int>& ele
 
 void FigmaQml::executeApp(const QVariantMap& parameters, const QVector<int>& elements) {
 #ifdef HAS_EXECUTE
+    if(!generateAll())
+        return;
     AppWrite::executeApp(parameters, *this, elements);
 #else
     (void) parameters;
@@ -1152,9 +1881,11 @@ QStringList FigmaQml::supportedQulHardware() const {
 }
 
 bool FigmaQml::saveQML(bool isMcu, const QString& folderName, bool writeAsApp, const QVector<int>& elements) {
+    if(!generateAll())
+        return false;
     if(isMcu) {
     #ifdef HAS_QUL
-        return  AppWrite::writeQul(folderName, *this, writeAsApp, elements);
+        return  AppWrite::writeQul(folderName, *this, writeAsApp, elements, m_flags & QulPreconvertImages);
     #else
         return false;
     #endif
@@ -1177,6 +1908,13 @@ void FigmaQml::findFontPath(const QString& fontFamilyName) const {
     m_fontInfo->getFontFilePath(font);
 }
 
+void FigmaQml::findFontPaths(const QStringList& fontFamilyNames) const {
+    QList<QFont> fonts;
+    for(const auto& family : QSet<QString>(fontFamilyNames.begin(), fontFamilyNames.end()))
+        fonts.append(QFont(family));
+    m_fontInfo->getFontFilePaths(fonts);
+}
+
 QByteArray FigmaQml::sourceCode(unsigned canvasIndex, unsigned elementIndex) const {
     const auto cit = m_sourceDoc->begin() + canvasIndex;
     const auto eit = (*cit)->begin() + elementIndex;
@@ -1184,13 +1922,6 @@ QByteArray FigmaQml::sourceCode(unsigned canvasIndex, unsigned elementIndex) con
 }
 
 
-static auto checksum(const QString& filename) {
-    QFile f(filename);
-    f.open(QFile::ReadOnly);
-    return qChecksum(f.readAll());
-}
-
-
 template <typename T>
 auto join(const T& vec, const QString& sep) {
     QString s;
@@ -1205,31 +1936,38 @@ auto join(const T& vec, const QString& sep) {
     return s;
 }
 
-std::optional<QString> FigmaQml::uniqueFilename(const QString& filename_proposal, const QByteArray& data) {
+// nullopt if the data is already written, then existing is the file name it was written into
+std::optional<QString> FigmaQml::uniqueFilename(const QString& filename_proposal, const QByteArray& data, QString* existing) {
     assert(data.size() > 1);
-    const auto data_crc = qChecksum(data);
+    const auto data_hash = hash64(data);
     auto filename = filename_proposal;
     for(;;) {
-        const auto it = m_crcs.find(filename);
-        if(it == m_crcs.end())
+        const auto it = m_hashes.find(filename);
+        if(it == m_hashes.end())
             break;
-        if(*it == data_crc) {
-            assert(QFile::exists(filename));
-            return std::nullopt; // CRC match its ok, but exists
+        if(*it == data_hash) {
+            if(existing)
+                *existing = filename; // may be renamed
+            return std::nullopt; // hash match its ok, but exists
         }
         const QFileInfo info(filename);
         filename = QFileInfo(info.path(), info.baseName() + QString::number(unique_number()) + "." + info.completeSuffix()).filePath();
     }
-    assert(!QFile::exists(filename));
-    m_crcs.insert(filename, data_crc);
+    m_hashes.insert(filename, data_hash);
     return filename;
 }
 
-bool FigmaQml::testFileExists(const QString& filename, const QByteArray& data) const {
-    if(!QFile::exists(filename))
-        return false;
-    qDebug() << "File exists" << filename << "known:" << m_crcs.contains(filename) << "is same:" << (qChecksum(data) == checksum(filename)) << "is read:" << (m_crcs.contains(filename) ? (qChecksum(data) == m_crcs[filename] ? "Yes" : "No") : "N/A");
-    return true;
+QStringList FigmaQml::unusedComponents() const {
+    return m_unusedComponents;
+}
+
+std::tuple<int, int> FigmaQml::elementStats() const {
+    const auto& stats = m_nodeCache->elementStats();
+    return {stats.rebuilt, stats.reused};
+}
+
+QString FigmaQml::uniqueName(const QString& id, const QString& name) const {
+    return m_names->name(id, name);
 }
 
 unsigned FigmaQml::unique_number() {
@@ -1238,26 +1976,38 @@ unsigned FigmaQml::unique_number() {
 }
 
 Q_INVOKABLE void FigmaQml::reset(bool keepFonts, bool keepSources, bool keepImages, bool keepFetch) {
+    if(deferred([this, keepFonts, keepSources, keepImages, keepFetch]() {reset(keepFonts, keepSources, keepImages, keepFetch);}))
+        return;
+    flushOutput(); // nothing is written after clean
     cleanDir(m_qmlDir);
-    m_imageFiles.clear();
+    clearImageFiles();
     m_externalLoaders.clear();
     m_uiDoc.reset();
+    m_lazyView.reset();
     if(!keepSources) {
         m_sourceDoc.reset();
+        m_lazySource.reset();
         m_externalLoaders.clear();
     }
     if(!keepFonts)
         m_fontCache->clear();
 
     if(!keepImages) {
-        m_imageFiles.clear();
-        m_crcs.clear();
+        clearImageFiles();
+        ++m_imageRevision; // provided images are fetched again
+        m_hashes.clear();
+        if(m_qmlStore)
+            m_qmlStore->clear();
         m_imageContexts.clear();
     }
 
     if(!keepFonts && !keepSources && !keepImages && !keepFetch) {
         m_imports = defaultImports();
         m_filter.clear();
+        m_pageSelection.clear();
+        m_frameSelection.clear();
+        m_nodeCache->clear();
+        m_names->clear();
         QDir(m_qmlDir).removeRecursively();
         m_unique_number = 1;
         mProvider.reset();
@@ -4,27 +4,136 @@
 
 #ifdef Q_OS_LINUX
 #include <QFont>
+#include <QFontInfo>
 #include <QCoreApplication>
 #include <QDebug>
 #include <QProcess>
+#include <QHash>
+#include <QVector>
+#include <optional>
+#include <algorithm>
+#include <cstdlib>
 #include "utils.h"
 
+// Qt and fontconfig weights are in different scales
+static int fcWeight(int weight) {
+#ifdef QT5
+    static const QVector<QPair<int, int>> weights{{0, 0}, {12, 40}, {25, 50}, {50, 80}, {57, 100}, {63, 180}, {75, 200}, {81, 205}, {87, 210}};
+#else
+    static const QVector<QPair<int, int>> weights{{100, 0}, {200, 40}, {300, 50}, {400, 80}, {500, 100}, {600, 180}, {700, 200}, {800, 205}, {900, 210}};
+#endif
+    if(weight <= weights.first().first)
+        return weights.first().second;
+    for(auto i = 1; i < weights.size(); ++i) {
+        const auto& [q0, f0] = weights[i - 1];
+        const auto& [q1, f1] = weights[i];
+        if(weight <= q1)
+            return f0 + (weight - q0) * (f1 - f0) / (q1 - q0);
+    }
+    return weights.last().second;
+}
+
+class FontInfo::Private {
+public:
+    struct Face {
+        QString file;
+        int weight;     // fontconfig scale
+        bool italic;
+    };
+    enum class State {None, Scanning, Ready, Failed};
+
+    void add(const QString& family, const Face& face) {
+        index[family.toLower()].append(face);
+    }
+
+    // fc-list output, each line has file, families, weight and slant
+    void parse(const QByteArray& list) {
+        for(const auto& line : list.split('\n')) {
+            const auto fields = QString::fromUtf8(line).split('\t');
+            if(fields.size() != 4 || fields[0].isEmpty())
+                continue;
+            // variable fonts have a range e.g. "[40 200]"
+            const auto weight = fields[2].mid(fields[2].startsWith('[') ? 1 : 0).section(' ', 0, 0).toInt();
+            const Face face{fields[0], weight, fields[3].toInt() > 0};
+            for(const auto& family : fields[1].split(','))
+                add(family, face);
+        }
+    }
 
-class FontInfo::Private : public QProcess {};
+    std::optional<QString> find(const QString& family, QFont::Style style, int weight) const {
+        auto it = index.constFind(family.toLower());
+        if(it == index.constEnd()) {
+            // substituted as Qt does
+            const QFontInfo fontInfo{QFont(family)};
+            it = index.constFind(fontInfo.family().toLower());
+            if(it == index.constEnd())
+                return std::nullopt;
+        }
+        const auto fc = fcWeight(weight);
+        const auto italic = style != QFont::StyleNormal;
+        const auto score = [fc, italic](const Face& face) {
+            return std::abs(face.weight - fc) + (face.italic != italic ? 1000 : 0);
+        };
+        const auto best = std::min_element(it->begin(), it->end(), [&score](const Face& a, const Face& b) {return score(a) < score(b);});
+        return best->file;
+    }
+public:
+    QProcess process;
+    State state = State::None;
+    QHash<QString, QVector<Face>> index;    // lower case family -> faces
+    QVector<std::function<void ()>> pending;
+};
 
 FontInfo::~FontInfo() {}
 
 FontInfo::FontInfo(QObject* parent) : QObject(parent), m_private{new Private} {
-    connect(m_private.get(), &QProcess::finished, this, [this](int exitCode, auto){
-        if(exitCode == 0) {
-            const auto fontFilePath = m_private->readAllStandardOutput().trimmed();
-            qDebug() << "fontFilePath" << fontFilePath;
-            emit fontPath(fontFilePath);
+    connect(&m_private->process, &QProcess::finished, this, [this](int exitCode, QProcess::ExitStatus exitStatus){
+        const auto pending = std::move(m_private->pending);
+        m_private->pending.clear();
+        if(exitCode == 0 && exitStatus == QProcess::NormalExit) {
+            m_private->parse(m_private->process.readAllStandardOutput());
+            m_private->state = Private::State::Ready;
+            for(const auto& query : pending)
+                query();
         } else {
-            qDebug() << "Error running fc-match:" << m_private->errorString();
-            emit pathError(m_private->errorString());
+            qDebug() << "Error running fc-list:" << m_private->process.errorString();
+            m_private->state = Private::State::Failed;
+            emit pathError(m_private->process.errorString());
         }
     });
+    connect(&m_private->process, &QProcess::errorOccurred, this, [this](QProcess::ProcessError error) {
+        if(error != QProcess::FailedToStart)
+            return; // finished is emitted
+        qDebug() << "Error running fc-list:" << m_private->process.errorString();
+        m_private->pending.clear();
+        m_private->state = Private::State::Failed;
+        emit pathError(m_private->process.errorString());
+    });
+}
+
+void FontInfo::whenIndexed(const std::function<void ()>& query) {
+    switch(m_private->state) {
+    case Private::State::Ready:
+        query();
+        break;
+    case Private::State::Failed:
+        emit pathError("Font index is not available");
+        break;
+    case Private::State::None:
+        m_private->state = Private::State::Scanning;
+        // one process lists all the fonts
+        m_private->process.start("fc-list", QStringList() << "--format=%{file}\t%{family}\t%{weight}\t%{slant}\n");
+        Q_FALLTHROUGH();
+    case Private::State::Scanning:
+        m_private->pending.append(query);
+        break;
+    }
+}
+
+void FontInfo::addFontFile(const QString& path, const QStringList& families, int weight, bool italic) {
+    const Private::Face face{path, fcWeight(weight), italic};
+    for(const auto& family : families)
+        m_private->add(family, face);
 }
 
 void FontInfo::getFontFilePath(const QFont& font) {
@@ -32,14 +141,27 @@ void FontInfo::getFontFilePath(const QFont& font) {
     }
 
 
-void FontInfo::getFontFilePath(const QString &family, QFont::Style style, int weight, int size) {
-    // Construct the font pattern string
-    const auto style_str = enumToString(style);
-    const auto fontPattern = QString("%1:style=%2:weight=%3:pixelSize=%4").arg(family, style_str).arg(weight).arg(size);
-
-    // Run fc-match to get the font file path
-    m_private->start("fc-match", QStringList() << "--format=%{file}" << fontPattern);
+void FontInfo::getFontFilePath(const QString &family, QFont::Style style, int weight, int) {
+    whenIndexed([this, family, style, weight]() {
+        const auto fontFilePath = m_private->find(family, style, weight);
+        qDebug() << "fontFilePath" << fontFilePath.value_or(QString());
+        if(fontFilePath)
+            emit fontPath(*fontFilePath);
+        else
+            emit pathError(QString("Font \"%1\" not found").arg(family));
+    });
+}
 
+void FontInfo::getFontFilePaths(const QList<QFont>& fonts) {
+    whenIndexed([this, fonts]() {
+        QVariantMap paths;
+        for(const auto& font : fonts) {
+            const auto fontFilePath = m_private->find(font.family(), font.style(), font.weight());
+            if(fontFilePath)
+                paths.insert(font.family(), *fontFilePath);
+        }
+        emit fontPaths(paths);
+    });
 }
 #else
 class FontInfo::Private {};
@@ -47,6 +169,8 @@ FontInfo::~FontInfo() {}
 FontInfo::FontInfo(QObject* parent) : QObject(parent) {}
 void  FontInfo::getFontFilePath(const QFont&) {}
 void  FontInfo::getFontFilePath(const QString &, QFont::Style , int , int ) {}
+void  FontInfo::getFontFilePaths(const QList<QFont>&) {}
+void  FontInfo::addFontFile(const QString&, const QStringList&, int, bool) {}
+void  FontInfo::whenIndexed(const std::function<void ()>&) {}
 #endif
 
-
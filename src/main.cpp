@@ -4,6 +4,11 @@
 #include "downloads.h"
 #include "functorslot.h"
 #include "utils.h"
+#include "figmaimageprovider.h"
+#ifndef Q_CC_EMSCRIPTEN
+#include "qmlstore.h"
+#include "qmlstorenetwork.h"
+#endif
 #include <QApplication>
 #include <QQmlApplicationEngine>
 #include <QQmlContext>
@@ -45,9 +50,11 @@ constexpr auto ORGANIZATION_DOMAIN {"figmaqml.com"};
 #ifdef _DEBUG
     #define print() qDebug()
 #else
+static bool printToStderr = false; // stdout is used for the output
 QTextStream& print() {
     static QTextStream r{stdout};
-    return r;
+    static QTextStream e{stderr};
+    return printToStderr ? e : r;
 }
 #endif
 
@@ -78,7 +85,8 @@ static QVector<QPair<QString, QString>> parseFontMap(const QString& str, bool us
 enum {
     CmdLine = 1,
     Store = 2,
-    ShowFonts = 4
+    ShowFonts = 4,
+    ShowUnused = 8
 };
 
 
@@ -102,6 +110,7 @@ int main(int argc, char *argv[]) {
     const QCommandLineOption renderFrameParameter("render-frame", "Render frames as images.");
     const QCommandLineOption imageDimensionMaxParameter("image-dimension-max", "Capping an image size, default is 1024.", "imageDimensionMax");
     const QCommandLineOption embedImagesParameter("embed-images", "Embed images into QML files.");
+    const QCommandLineOption atlasImagesParameter("atlas-images", "Pack small images and renderings into atlas textures (not in Qt for MCU mode).");
     const QCommandLineOption breakBooleansParameter("break-boolean", "Break Figma boolean shapes to QtQuick items.");
     const QCommandLineOption antialiasingShapesParameter("antialiasing-shapes", "Add antialiasing property to shapes.");
     const QCommandLineOption importsParameter("imports", "QML imports, ';' separated list of imported modules as <module-name> <version-number>.", "imports");
@@ -110,17 +119,27 @@ int main(int argc, char *argv[]) {
     const QCommandLineOption timedParameter("timed", "Time parsing process.");
     const QCommandLineOption figmaFontParameter("keepFigmaFont", "Do not resolve fonts, keep original font names.");
     const QCommandLineOption showFontsParameter("show-fonts", "Show the font mapping.");
+    const QCommandLineOption showUnusedParameter("show-unused", "Show the components that are not used by the converted views, those are not generated.");
     const QCommandLineOption fontFolderParameter("font-folder", "Add an additional path to search fonts.", "fontFolder");
     const QCommandLineOption showParameter("show", "Set current page and view to <page index>-<view index>, indexing starts from 1.", "show");
     const QCommandLineOption altFontMatchParameter("alt-font-match", "Use alternative font matching algorithm.");
     const QCommandLineOption fontMapParameter("font-map", "Provide a ';' separated list of <figma font>':'<system font> pairs.", "fontMap");
     const QCommandLineOption throttleParameter("throttle", "Milliseconds between server requests. Too frequent request may have issues, especially with big desings - default 300", "throttle");
     const QCommandLineOption qulmodeParameter("qul-mode", "QtQuick for Qt for MCU");
+    const QCommandLineOption qulPreconvertImagesParameter("qul-preconvert-images", "Convert opaque images to RGB565 when a Qt for MCU project is written.");
     const QCommandLineOption staticCodeParameter("static-code", "Do not generate any dynamic, interactive code, property access, event handlers etc.");
+    const QCommandLineOption pagesParameter("pages", "Convert only the given pages, ';' separated list of page indices (starting from 1), names or ids.", "pages");
+    const QCommandLineOption streamParameter("stream", "Generate and write one view at time, memory is released after each view is written. For huge designs.");
+    const QCommandLineOption framesParameter("frames", "Convert only the given views, ';' separated list of view indices (starting from 1 on each page), names or ids.", "frames");
 
+#ifdef ZIP_EXPORT
+    const QString zipHelp(" Output ending with '.zip', or '-' for stdout, is written into a zip archive.");
+#else
+    const QString zipHelp;
+#endif
     parser.addPositionalArgument("argument 1", "Optional: .figmaqml file or user token. GUI opened if empty.", "<FIGMAQML_FILE>|<USER_TOKEN>");
-    parser.addPositionalArgument("argument 2", "Optional: Output directory name (or .figmaqml file name if '--store' is given), assuming the first parameter was the restored file. If empty, GUI is opened. Project token is expected if the first parameter was an user token.", "<OUTPUT if FIGMAQML_FILE>| PROJECT_TOKEN if USER_TOKEN");
-    parser.addPositionalArgument("argument 3", "Optional: Output directory name (or .figmaqml file name if '--store' is given), assuming the user and project tokens were provided. ", "<OUTPUT if USER_TOKEN>");
+    parser.addPositionalArgument("argument 2", "Optional: Output directory name (or .figmaqml file name if '--store' is given), assuming the first parameter was the restored file. If empty, GUI is opened. Project token is expected if the first parameter was an user token." + zipHelp, "<OUTPUT if FIGMAQML_FILE>| PROJECT_TOKEN if USER_TOKEN");
+    parser.addPositionalArgument("argument 3", "Optional: Output directory name (or .figmaqml file name if '--store' is given), assuming the user and project tokens were provided. " + zipHelp, "<OUTPUT if USER_TOKEN>");
 
     parser.addOptions({
                           renderFrameParameter,
@@ -128,20 +147,26 @@ int main(int argc, char *argv[]) {
                           breakBooleansParameter,
                           antialiasingShapesParameter,
                           embedImagesParameter,
+                          atlasImagesParameter,
                           importsParameter,
                           snapParameter,
                           storeParameter,
                           timedParameter,
                           showParameter,
                           showFontsParameter,
+                          showUnusedParameter,
                           fontFolderParameter,
                           altFontMatchParameter,
                           fontMapParameter,
                           throttleParameter,
                           figmaFontParameter,
                           staticCodeParameter,
+                          pagesParameter,
+                          framesParameter,
+                          streamParameter,
 #ifdef HAS_QUL
                           qulmodeParameter,
+                          qulPreconvertImagesParameter,
 #endif
                       });
 
@@ -186,12 +211,20 @@ int main(int argc, char *argv[]) {
     if(!output.isEmpty())
         state |= CmdLine;
 
+#if defined(ZIP_EXPORT) && !defined(_DEBUG)
+    if(output == "-")
+        printToStderr = true;
+#endif
+
     if(parser.isSet(storeParameter))
         state |= Store;
 
     if(parser.isSet(showFontsParameter))
         state |= ShowFonts;
 
+    if(parser.isSet(showUnusedParameter))
+        state |= ShowUnused;
+
     if(!snapFile.isEmpty() && !(userToken.isEmpty() || restore.isEmpty())) {
         parser.showHelp(-2);
     }
@@ -262,12 +295,16 @@ int main(int argc, char *argv[]) {
                 qmlFlags |= FigmaQml::AntialiasingShapes;
             if(parser.isSet(embedImagesParameter))
                 qmlFlags |= FigmaQml::EmbedImages;
+            if(parser.isSet(atlasImagesParameter))
+                qmlFlags |= FigmaQml::AtlasImages;
             if(parser.isSet(altFontMatchParameter))
                 qmlFlags |= FigmaQml::AltFontMatch;
             if(parser.isSet(figmaFontParameter))
                 qmlFlags |= FigmaQml::KeepFigmaFontName;
             if(parser.isSet(qulmodeParameter))
                 qmlFlags |= FigmaQml::QulMode;
+            if(parser.isSet(qulPreconvertImagesParameter))
+                qmlFlags |= FigmaQml::QulPreconvertImages;
             if(parser.isSet(staticCodeParameter))
                 qmlFlags |= FigmaQml::StaticCode;
             if(parser.isSet(importsParameter)) {
@@ -308,6 +345,15 @@ int main(int argc, char *argv[]) {
 
          if(parser.isSet(throttleParameter))
             figmaGet->setProperty("throttle", parser.value(throttleParameter));
+
+         if(parser.isSet(pagesParameter) || parser.isSet(framesParameter)) {
+             const auto pages = parser.isSet(pagesParameter) ? parser.value(pagesParameter).split(';', Qt::SkipEmptyParts) : QStringList{};
+             const auto frames = parser.isSet(framesParameter) ? parser.value(framesParameter).split(';', Qt::SkipEmptyParts) : QStringList{};
+             figmaQml->setFilter(pages, frames);
+         }
+
+         if(parser.isSet(streamParameter))
+             figmaQml->setStreaming(true);
      }
 
 
@@ -364,8 +410,15 @@ int main(int argc, char *argv[]) {
                           excode = -1;
                          }
                  } else if(!output.isEmpty()) {
+#ifdef ZIP_EXPORT
+                    const auto zipped = output == "-" || output.endsWith(".zip");
+                    if(zipped ? figmaQml->saveAllQMLToZip(output) : figmaQml->saveAllQML(output)) {
+#else
                     if(figmaQml->saveAllQML(output)) {
+#endif
+                        const auto [rebuilt, reused] = figmaQml->elementStats();
                         ::print() << "\nSaved to " << output << Qt::endl;
+                        ::print() << "Elements rebuilt: " << rebuilt << ", reused: " << reused << Qt::endl;
                     } else {
                         ::print() << "\nSave to " << output << " failed" << Qt::endl;
                         excode = -1;
@@ -378,6 +431,12 @@ int main(int argc, char *argv[]) {
                          ::print() << "Font: " << k << "->" << fonts[k].toString() << Qt::endl;
                      }
                  }
+                 if(state & ShowUnused) {
+                     const auto unused = figmaQml->unusedComponents();
+                     for(const auto& c : unused) {
+                         ::print() << "Unused component: " << c << Qt::endl;
+                     }
+                 }
                  loop.quit();
              });
              exit.start(400);
@@ -500,10 +559,25 @@ int main(int argc, char *argv[]) {
     }
 
 
+#ifndef Q_CC_EMSCRIPTEN
+    const auto qmlStore = std::make_shared<QmlStore>();
+    QmlStoreFactory qmlStoreFactory(qmlStore); // outlives the engine
+#endif
     QQmlApplicationEngine engine;
     FigmaQmlInterface::registerFigmaQmlSingleton(engine);
 
     if(!(state & CmdLine)) {
+         figmaQml->setLazy(true); // elements are generated when viewed
+#ifndef Q_CC_EMSCRIPTEN
+         // viewed QML is served from the memory
+         figmaQml->setQmlStore(qmlStore);
+         engine.setNetworkAccessManagerFactory(&qmlStoreFactory);
+#endif
+         // viewed images are decoded by the provider, engine owns it
+         const auto imageProvider = new FigmaImageProvider(*figmaGet);
+         engine.addImageProvider(FigmaImageProvider::Id, imageProvider);
+         QObject::connect(figmaGet.get(), &FigmaGet::resetted, &engine, [imageProvider]() {imageProvider->clear();});
+         figmaQml->setImageProvider(true);
          onDataChange = [&figmaGet, &figmaQml]() {
                       figmaQml->createDocumentView(figmaGet->data(), true);
                   };
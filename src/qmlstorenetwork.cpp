@@ -0,0 +1,74 @@
+#include "qmlstorenetwork.h"
+#include "qmlstore.h"
+#include <QTimer>
+#include <algorithm>
+#include <cstring>
+
+QmlStoreReply::QmlStoreReply(const QNetworkRequest& request, const std::optional<QByteArray>& data, QObject* parent) : QNetworkReply(parent),
+    m_data(data.value_or(QByteArray())) {
+    setRequest(request);
+    setUrl(request.url());
+    setOperation(QNetworkAccessManager::GetOperation);
+    open(QIODevice::ReadOnly | QIODevice::Unbuffered);
+    if(data) {
+        setHeader(QNetworkRequest::ContentLengthHeader, m_data.size());
+        setAttribute(QNetworkRequest::HttpStatusCodeAttribute, 200);
+    } else {
+        setError(QNetworkReply::ContentNotFoundError, QString("%1 not found").arg(request.url().toString()));
+    }
+    // signals are expected after the reply is returned
+    QTimer::singleShot(0, this, [this]() {
+        if(isFinished()) // aborted
+            return;
+        emit metaDataChanged();
+        if(error() != QNetworkReply::NoError)
+            emit errorOccurred(error());
+        else
+            emit readyRead();
+        setFinished(true);
+        emit finished();
+    });
+}
+
+void QmlStoreReply::abort() {
+    if(isFinished())
+        return;
+    m_offset = m_data.size(); // nothing to read
+    setError(QNetworkReply::OperationCanceledError, QString("%1 aborted").arg(url().toString()));
+    emit errorOccurred(error());
+    setFinished(true);
+    emit finished();
+}
+
+qint64 QmlStoreReply::bytesAvailable() const {
+    return m_data.size() - m_offset + QNetworkReply::bytesAvailable();
+}
+
+bool QmlStoreReply::isSequential() const {
+    return true;
+}
+
+qint64 QmlStoreReply::readData(char* data, qint64 maxSize) {
+    if(m_offset >= m_data.size())
+        return -1;
+    const auto count = std::min<qint64>(maxSize, m_data.size() - m_offset);
+    std::memcpy(data, m_data.constData() + m_offset, static_cast<size_t>(count));
+    m_offset += count;
+    return count;
+}
+
+QmlStoreAccessManager::QmlStoreAccessManager(const std::shared_ptr<const QmlStore>& store, QObject* parent) : QNetworkAccessManager(parent), m_store(store) {
+}
+
+QNetworkReply* QmlStoreAccessManager::createRequest(Operation op, const QNetworkRequest& request, QIODevice* outgoingData) {
+    if(op == GetOperation && request.url().scheme() == QLatin1String(QmlStore::Scheme))
+        return new QmlStoreReply(request, m_store->value(request.url()), this);
+    return QNetworkAccessManager::createRequest(op, request, outgoingData);
+}
+
+QmlStoreFactory::QmlStoreFactory(const std::shared_ptr<const QmlStore>& store) : m_store(store) {
+}
+
+QNetworkAccessManager* QmlStoreFactory::create(QObject* parent) {
+    return new QmlStoreAccessManager(m_store, parent);
+}
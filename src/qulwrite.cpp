@@ -1,4 +1,12 @@
 #include <QFileInfo>
+#include <QFile>
+#include <QSaveFile>
+#include <QDirIterator>
+#include <QImage>
+#include <QThreadPool>
+#include <QMap>
+#include <vector>
+#include <tuple>
 #include "appwrite.h"
 #include "execute_utils.h"
 
@@ -6,7 +14,88 @@
 #error HAS_QUL expected
 #endif
 
-bool AppWrite::writeQul(const QString& path, const FigmaQml& figmaQml, bool writeAsApp, const QVector<int>& elements) {
+namespace {
+// resource properties of an image group in the qmlproject
+struct ImageResource {
+    QString pixelFormat = "Automatic";
+    bool compression = false;
+    QString cachePolicy = "OnDemand";
+    bool operator<(const ImageResource& other) const {
+        return std::tie(pixelFormat, compression, cachePolicy) < std::tie(other.pixelFormat, other.compression, other.cachePolicy);
+    }
+};
+
+constexpr qsizetype LargeImage = 64 * 1024;    // bytes in RAM
+constexpr qsizetype SmallImage = 16 * 1024;
+constexpr int FrequentUse = 3;
+
+// how many times images are referred in the QML files
+QHash<QString, int> imageUses(const QString& folder) {
+    static const QRegularExpression re(R"(images/([^"]+)")");
+    QHash<QString, int> uses;
+    QDirIterator it(folder, {"*.qml"}, QDir::Files, QDirIterator::Subdirectories);
+    while(it.hasNext()) {
+        QFile file(it.next());
+        if(!file.open(QIODevice::ReadOnly))
+            continue;
+        const auto content = QString::fromUtf8(file.readAll());
+        for(const auto& m : re.globalMatch(content))
+            ++uses[m.captured(1)];
+    }
+    return uses;
+}
+
+// choose properties by the image content and use
+ImageResource imageResource(const QString& fileName, int uses, bool preconvert) {
+    ImageResource resource;
+    auto image = QImage(fileName);
+    if(image.isNull())
+        return resource;
+    image = image.convertToFormat(QImage::Format_ARGB32);
+    bool opaque = true;
+    qsizetype runs = 0; // rle is efficient if there are long runs of the same pixel
+    for(auto y = 0; y < image.height(); ++y) {
+        const auto line = reinterpret_cast<const QRgb*>(image.constScanLine(y));
+        for(auto x = 0; x < image.width(); ++x) {
+            opaque = opaque && qAlpha(line[x]) == 0xFF;
+            if(x == 0 || line[x] != line[x - 1])
+                ++runs;
+        }
+    }
+    const qsizetype pixels = static_cast<qsizetype>(image.width()) * image.height();
+    resource.compression = runs * 4 < pixels;
+    const auto bytes = pixels * (opaque ? 2 : 4);
+    if(opaque) {
+        resource.pixelFormat = "RGB565";
+        if(preconvert) {
+            // dithered here as the resource compiler just truncates, QSaveFile does not write via the hard link
+            const auto converted = image.convertToFormat(QImage::Format_RGB16, Qt::DiffuseDither).convertToFormat(QImage::Format_RGB32);
+            QSaveFile file(fileName);
+            if(file.open(QIODevice::WriteOnly) && converted.save(&file, "PNG"))
+                file.commit();
+        }
+    }
+    if(!resource.compression && uses <= 1 && bytes >= LargeImage)
+        resource.cachePolicy = "NoCaching";   // drawn from the flash, saves RAM
+    else if(uses >= FrequentUse && bytes <= SmallImage)
+        resource.cachePolicy = "OnStartup";
+    return resource;
+}
+
+QString imageFilesNode(const ImageResource& resource, const QStringList& files, const char* join) {
+    return QString("    ImageFiles {\n"
+                   "        files: [%1]\n"
+                   "        MCU.resourceCompression: %2\n"
+                   "        MCU.resourceImagePixelFormat: \"%3\"\n"
+                   "        MCU.resourceCachePolicy: \"%4\"\n"
+                   "        MCU.resourceOptimizeForRotation: false\n"
+                   "        MCU.resourceOptimizeForScale: false\n"
+                   "    }\n\n")
+            .arg(files.join(join), resource.compression ? "true" : "false", resource.pixelFormat, resource.cachePolicy);
+}
+}
+
+bool AppWrite::writeQul(const QString& path, const FigmaQml& figmaQml, bool writeAsApp, const QVector<int>& elements, bool preconvertImages) {
     const auto res = ExecuteUtils::writeResources(path, figmaQml, writeAsApp, elements);
     if(!res)
         return false;
@@ -19,13 +108,40 @@ bool AppWrite::writeQul(const QString& path, const FigmaQml& figmaQml, bool writ
     // note a colon
     VERIFY(ExecuteUtils::replaceInFile(path + "/FigmaQmlInterface/FigmaQmlInterface.qmlproject.in", re_project, R"(\1,)" + ExecuteUtils::qq(qml_files).join(JOIN) + R"(\2)", {"Project", "QmlFiles"}), "Cannot update qmlproject");
 
-    QStringList local_images;
-    std::transform(images.begin(), images.end(), std::back_inserter(local_images), [](const auto& f){return ExecuteUtils::qq("images/" + QFileInfo(f).fileName());});
+    // images are analysed in parallel and grouped by the resource properties
+    const auto uses = imageUses(path + '/' + FOLDER);
+    std::vector<ImageResource> resources(static_cast<size_t>(images.size()));
+    QThreadPool pool;
+    for(auto i = 0; i < images.size(); ++i) {
+        const auto fileName = images[i];
+        auto& resource = resources[static_cast<size_t>(i)];
+        const auto used = uses.value(QFileInfo(fileName).fileName());
+        pool.start([&resource, fileName, used, preconvertImages]() {
+            resource = imageResource(fileName, used, preconvertImages);
+        });
+    }
+    pool.waitForDone();
+
+    QMap<ImageResource, QStringList> groups;
+    for(auto i = 0; i < images.size(); ++i)
+        groups[resources[static_cast<size_t>(i)]].append(ExecuteUtils::qq("images/" + QFileInfo(images[i]).fileName()));
 
-    static const QRegularExpression re_images (R"((^\s*files:\s*\[\s*)(\s*(?:@[A-Z_]+@)?\s*\]))");
+    QString image_nodes;
+    for(const auto& [resource, files] : groups.asKeyValueRange())
+        image_nodes += imageFilesNode(resource, files, JOIN);
 
-    if(!local_images.isEmpty())
-        VERIFY(ExecuteUtils::replaceInFile(path + "/FigmaQmlInterface/FigmaQmlInterface.qmlproject.in", re_images, R"(\1)" + local_images.join(JOIN) + R"(\2)", {"Project", "ImageFiles"}), "Cannot update qmlproject");
+    if(!image_nodes.isEmpty()) {
+        const auto project_file = path + "/FigmaQmlInterface/FigmaQmlInterface.qmlproject.in";
+        QFile project(project_file);
+        VERIFY(project.open(QIODevice::ReadOnly), "Cannot read qmlproject");
+        auto content = QString::fromUtf8(project.readAll());
+        project.close();
+        static const QRegularExpression re_modules(R"(^([ \t]*ModuleFiles\s*\{))", QRegularExpression::MultilineOption);
+        VERIFY(re_modules.match(content).hasMatch(), "Cannot update qmlproject");
+        content.replace(re_modules, image_nodes + R"(\1)");
+        VERIFY(project.open(QIODevice::WriteOnly | QIODevice::Truncate), "Cannot update qmlproject");
+        VERIFY((project.write(content.toUtf8()) >= 0), "Cannot update qmlproject");
+    }
 
     static const QRegularExpression re_qml(R"(\/\*element_declarations\*\/)");
     VERIFY(ExecuteUtils::replaceInFile(path + "/FigmaQmlInterface/FigmaQmlInterface.hpp", re_qml, ExecuteUtils::qq(qml_item_names).join(","), {}, true), "Cannot update cpp file");
@@ -0,0 +1,47 @@
+/*
+ * Checks the component closure and order of FigmaDocument over nested components.
+ *
+ * Build and run (from the repository root):
+ *   g++ -std=c++17 -fPIC -Iinclude test/componentorder_test.cpp $(pkg-config --cflags --libs Qt6Core) -o componentorder_test
+ *   ./componentorder_test
+ *
+ * Returns non zero if a check fails.
+ */
+
+#include <QDebug>
+#include "figmadocument.h"
+#include <QTextStream>
+
+static int failures = 0;
+
+static void check(const QStringList& value, const QStringList& expected, const char* what) {
+    if(value != expected) {
+        QTextStream(stderr) << what << ": got [" << value.join(", ") << "], expected [" << expected.join(", ") << "]\n";
+        ++failures;
+    }
+}
+
+int main() {
+    OutputWriter writer(1);
+    FigmaDataDocument doc(QString(), "test", writer, nullptr);
+    // as FigmaQml::addElement and FigmaQml::writeComponents set them: view -> A -> B -> C
+    doc.setComponents("view", {"A_figma"});
+    doc.setComponents("A_figma", {"B_figma"});
+    doc.setComponents("B_figma", {"C_figma"});
+    doc.setComponents("C_figma", {});
+
+    check(doc.dependencies("view"), {"A_figma", "B_figma", "C_figma"}, "view closure");
+    check(doc.dependencies("A_figma"), {"B_figma", "C_figma"}, "component closure");
+    check(doc.dependencies("C_figma"), {}, "leaf closure");
+    // each component after the components it uses
+    check(doc.componentOrder(), {"C_figma", "B_figma", "A_figma"}, "component order");
+
+    // a shared component is written once, before its users
+    doc.setComponents("view2", {"D_figma"});
+    doc.setComponents("D_figma", {"B_figma"});
+    check(doc.dependencies("view2"), {"B_figma", "C_figma", "D_figma"}, "shared closure");
+    check(doc.componentOrder(), {"C_figma", "B_figma", "A_figma", "D_figma"}, "shared order");
+
+    QTextStream(stdout) << (failures ? "FAILED" : "OK") << '\n';
+    return failures;
+}
@@ -0,0 +1,143 @@
+/*
+ * Compares the alternative font match of FontIndex against the earlier full Levenshtein loop.
+ *
+ * Build and run (from the repository root):
+ *   g++ -O2 -std=c++17 -fPIC -Iinclude test/fontindex_bench.cpp $(pkg-config --cflags --libs Qt6Core) -o fontindex_bench
+ *   ./fontindex_bench [families] [queries]
+ *
+ * Family names and queries are synthetic and generated from a fixed seed, so runs are comparable.
+ */
+
+#include "fontindex.h"
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <cstdlib>
+#include <vector>
+
+// the implementation that FontIndex replaced
+static int levenshteinDistance(const QString& s1, const QString& s2) {
+    const auto l1 = s1.length();
+    const auto l2 = s2.length();
+
+    auto dist = std::vector<std::vector<int>>(l2 + 1, std::vector<int>(l1 + 1));
+
+    for(auto i = 0; i <= l1 ; i++) {
+       dist[0][i] = i;
+    }
+
+    for(auto j = 0; j <= l2; j++) {
+       dist[j][0] = j;
+    }
+    for (auto j = 1; j <= l1; j++) {
+       for(auto i = 1; i <= l2 ;i++) {
+          const auto track = (s2[i-1] == s1[j-1]) ? 0 : 1;
+          const auto t = std::min((dist[i - 1][j] + 1), (dist[i][j - 1] + 1));
+          dist[i][j] = std::min(t, (dist[i - 1][j - 1] + track));
+       }
+    }
+    return dist[l2][l1];
+}
+
+static QString previousNearest(const QStringList& fontFamilies, const QString& requestedFont) {
+    int min = std::numeric_limits<int>::max();
+    int index = -1;
+    for(auto ff = 0; ff < fontFamilies.size() ; ff++) {
+        const auto distance = levenshteinDistance(fontFamilies[ff], requestedFont);
+        if(distance < min) {
+            index = ff;
+            min = distance;
+        }
+    }
+    return index < 0 ? requestedFont : fontFamilies[index];
+}
+
+// deterministic, independent of the standard library
+class Random {
+public:
+    unsigned next(unsigned range) {
+        m_state = m_state * 6364136223846793005ULL + 1442695040888963407ULL;
+        return static_cast<unsigned>(m_state >> 33) % range;
+    }
+private:
+    quint64 m_state = 0x5eed;
+};
+
+static QString word(Random& random) {
+    static const QString letters("abcdefghijklmnopqrstuvwxyz");
+    QString w(letters[random.next(26)].toUpper());
+    const auto length = 3 + random.next(7);
+    for(auto i = 0U; i < length; ++i)
+        w += letters[random.next(26)];
+    return w;
+}
+
+static QStringList families(Random& random, int count) {
+    static const QStringList styles{"", "", " Regular", " Bold", " Light", " Medium", " Italic", " Condensed", " Mono"};
+    QStringList list;
+    while(list.size() < count) {
+        auto family = word(random);
+        if(random.next(2))
+            family += ' ' + word(random);
+        family += styles[random.next(styles.size())];
+        if(!list.contains(family))
+            list.append(family);
+    }
+    return list;
+}
+
+// a known family with a weight suffix and a few typos, as in Figma documents
+static QStringList queries(Random& random, const QStringList& families, int count) {
+    static const QStringList weights{"", " Regular", " SemiBold", " Bold", " ExtraLight"};
+    QStringList list;
+    for(auto i = 0; i < count; ++i) {
+        auto query = families[random.next(families.size())];
+        const auto edits = random.next(3);
+        for(auto e = 0U; e < edits && query.size() > 1; ++e) {
+            const auto at = random.next(query.size());
+            switch(random.next(3)) {
+            case 0: query.remove(at, 1); break;
+            case 1: query.insert(at, QChar('a' + random.next(26))); break;
+            default: query[at] = QChar('a' + random.next(26));
+            }
+        }
+        list.append(query + weights[random.next(weights.size())]);
+    }
+    return list;
+}
+
+int main(int argc, char* argv[]) {
+    const auto familyCount = argc > 1 ? std::atoi(argv[1]) : 3000;
+    const auto queryCount = argc > 2 ? std::atoi(argv[2]) : 200;
+    Random random;
+    const auto fontFamilies = families(random, familyCount);
+    const auto requests = queries(random, fontFamilies, queryCount);
+    QTextStream out(stdout);
+
+    QElapsedTimer timer;
+    timer.start();
+    QStringList previous;
+    for(const auto& request : requests)
+        previous.append(previousNearest(fontFamilies, request));
+    const auto previousTime = timer.elapsed();
+
+    timer.restart();
+    const FontIndex index(fontFamilies);
+    QStringList indexed;
+    for(const auto& request : requests)
+        indexed.append(index.nearest(request).value_or(request));
+    const auto indexedTime = timer.elapsed();
+
+    // the index folds weight suffixes, the previous loop did not, hence they may disagree
+    int differ = 0;
+    for(auto i = 0; i < requests.size(); ++i) {
+        if(previous[i] != indexed[i]) {
+            ++differ;
+            out << requests[i] << ": \"" << previous[i] << "\" vs \"" << indexed[i] << "\"\n";
+        }
+    }
+    out << familyCount << " families, " << queryCount << " queries\n"
+        << "previous loop: " << previousTime << " ms\n"
+        << "indexed search: " << indexedTime << " ms\n"
+        << "different matches: " << differ << '\n';
+    return 0;
+}